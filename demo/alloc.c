@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h> // malloc, posix_memalign
+#include <stdint.h>
+#include <string.h> // strcmp, strstr, memcpy
+#include <unistd.h> // sysconf
+#include <sys/mman.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "alloc.h"
+
+static const char *names[] = { "malloc", "align64", "page", "thp", "hugetlb" };
+
+int alloc_parse (const char *str, enum alloc_mode *mode) {
+   unsigned i;
+
+   for (i=0; i<sizeof names / sizeof names[0]; i++)
+      if (strcmp (str, names[i]) == 0) {
+         *mode = (enum alloc_mode) i;
+         return 0;
+      }
+
+   return -1;
+}
+
+const char *alloc_name (enum alloc_mode mode) {
+   return names [mode];
+}
+
+static size_t round_up (size_t len, size_t unit) {
+   return (len + unit - 1) / unit * unit;
+}
+
+/* "always [madvise] never": THP usable unless never is selected */
+static int thp_enabled (void) {
+   char buf [128];
+
+   FILE *fp = fopen ("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+   if (fp == NULL) return 0;
+   const int ok = fgets (buf, sizeof buf, fp) != NULL;
+   fclose (fp);
+
+   return ok && strstr (buf, "[never]") == NULL;
+}
+
+enum alloc_mode alloc_probe (enum alloc_mode mode, FILE *fp) {
+   if (mode == ALLOC_HUGETLB) {
+      void *p = mmap (NULL, HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p != MAP_FAILED) {
+         munmap (p, HUGE_PAGE_SIZE);
+         return mode;
+      }
+      fprintf (fp, "Allocation: no huge page reserved (see /proc/sys/vm/nr_hugepages), falling back to thp\n");
+      mode = ALLOC_THP;
+   }
+
+   if (mode == ALLOC_THP && !thp_enabled()) {
+      fprintf (fp, "Allocation: transparent huge pages disabled, falling back to page\n");
+      mode = ALLOC_PAGE;
+   }
+
+   return mode;
+}
+
+/* 2 MB aligned anonymous mapping with transparent huge pages requested, of
+   len rounded up to 2 MB: released by munmap like a MAP_HUGETLB mapping */
+static void *thp_mmap (size_t len) {
+   const size_t map_len = round_up (len, HUGE_PAGE_SIZE);
+   static int warned = 0;
+
+   char *p = mmap (NULL, map_len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (p == MAP_FAILED) return NULL;
+   if (!warned++)
+      fprintf (stderr, "Allocation: not enough huge pages reserved, falling back to thp\n");
+
+   /* trim to the first 2 MB boundary */
+   const size_t head = (HUGE_PAGE_SIZE - (uintptr_t) p % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+   if (head > 0) munmap (p, head);
+   munmap (p + head + map_len, HUGE_PAGE_SIZE - head);
+   madvise (p + head, map_len, MADV_HUGEPAGE);
+
+   return p + head;
+}
+
+void *alloc_array (enum alloc_mode mode, size_t len) {
+   void *p = NULL;
+
+   switch (mode) {
+   case ALLOC_MALLOC:
+      return malloc (len);
+   case ALLOC_ALIGN64:
+      return posix_memalign (&p, 64, len) == 0 ? p : NULL;
+   case ALLOC_PAGE:
+      return posix_memalign (&p, sysconf (_SC_PAGESIZE), len) == 0 ? p : NULL;
+   case ALLOC_THP:
+      if (posix_memalign (&p, HUGE_PAGE_SIZE, round_up (len, HUGE_PAGE_SIZE)) != 0) return NULL;
+      madvise (p, round_up (len, HUGE_PAGE_SIZE), MADV_HUGEPAGE);
+      return p;
+   case ALLOC_HUGETLB:
+      p = mmap (NULL, round_up (len, HUGE_PAGE_SIZE), PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p != MAP_FAILED) return p;
+      /* reserved pages exhausted (alloc_probe only tried one) */
+      return thp_mmap (len);
+   }
+
+   return NULL;
+}
+
+void alloc_release (enum alloc_mode mode, void *p, size_t len) {
+   if (p == NULL) return;
+
+   /* huge pages or their thp_mmap fallback */
+   if (mode == ALLOC_HUGETLB)
+      munmap (p, round_up (len, HUGE_PAGE_SIZE));
+   else
+      free (p);
+}
+
+void alloc_stream_copy (void *dst, const void *src, size_t len) {
+#ifdef __SSE2__
+   /* head up to the first 16-byte boundary of dst, then non-temporal stores */
+   const size_t align = (16 - (uintptr_t) dst % 16) % 16;
+   const size_t head = align < len ? align : len;
+   char *d = (char *) dst + head;
+   const char *s = (const char *) src + head;
+   const size_t nb = (len - head) / 16;
+   size_t i;
+
+   memcpy (dst, src, head);
+   #pragma omp parallel
+   {
+      #pragma omp for schedule(static) nowait
+      for (i=0; i<nb; i++)
+         _mm_stream_si128 ((__m128i *) (d + 16*i), _mm_loadu_si128 ((const __m128i *) (s + 16*i)));
+      /* streaming stores are only ordered by fences */
+      _mm_sfence();
+   }
+   memcpy (d + 16*nb, s + 16*nb, len - head - 16*nb);
+#else
+   memcpy (dst, src, len);
+#endif
+}
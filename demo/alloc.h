@@ -0,0 +1,40 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Allocation modes of the benchmark arrays */
+
+enum alloc_mode {
+   ALLOC_MALLOC,  /* default malloc alignment */
+   ALLOC_ALIGN64, /* cache-line aligned */
+   ALLOC_PAGE,    /* page aligned */
+   ALLOC_THP,     /* 2 MB aligned, transparent huge pages requested with madvise */
+   ALLOC_HUGETLB, /* explicit 2 MB pages, mmap MAP_HUGETLB */
+};
+
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+/* "malloc", "align64", "page", "thp" or "hugetlb". Returns -1 if invalid */
+int alloc_parse (const char *str, enum alloc_mode *mode);
+
+const char *alloc_name (enum alloc_mode mode);
+
+/* Mode actually usable on this host: hugetlb falls back to thp when no huge
+   page is reserved, thp to page when THP is disabled. Reports on fp */
+enum alloc_mode alloc_probe (enum alloc_mode mode, FILE *fp);
+
+/* len bytes in the given (probed) mode, NULL on failure. hugetlb falls back
+   to thp for an allocation when the reserved huge pages run out */
+void *alloc_array (enum alloc_mode mode, size_t len);
+
+void alloc_release (enum alloc_mode mode, void *p, size_t len);
+
+/* memcpy with non-temporal stores where available: dst is written without
+   being read into the caches (and whatever of it they held is evicted), so a
+   restore leaves the cache state of the other arrays unchanged. Split over the
+   OpenMP threads with a static schedule */
+void alloc_stream_copy (void *dst, const void *src, size_t len);
+
+#endif
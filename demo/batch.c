@@ -0,0 +1,59 @@
+#include <stdint.h>
+#include <omp.h>
+
+#include "batch.h"
+
+static void solve_row (const struct kernel_problem *p, unsigned i) {
+   const unsigned n = p->n;
+   const float *c = p->c + (uint64_t) i * n;
+   float sum = 0.0f;
+   unsigned j;
+
+   #pragma omp simd reduction(+:sum)
+   for (j=0; j<n; j++)
+      sum += c[j];
+
+   p->a[i] += sum * (1.0f / p->b[i]);
+}
+
+static uint64_t cost (const struct kernel_problem *p) {
+   return (uint64_t) p->n * p->n;
+}
+
+void kernel_batch (unsigned nb, const struct kernel_problem p[]) {
+   uint64_t total = 0, small_total = 0;
+   unsigned k;
+
+   for (k=0; k<nb; k++) total += cost (&p[k]);
+   uint64_t split = total / omp_get_max_threads();
+   if (split < BATCH_SPLIT_MIN_ELEMS) split = BATCH_SPLIT_MIN_ELEMS;
+   for (k=0; k<nb; k++)
+      if (cost (&p[k]) < split) small_total += cost (&p[k]);
+
+   #pragma omp parallel private(k)
+   {
+      const uint64_t t = omp_get_thread_num();
+      const uint64_t nt = omp_get_num_threads();
+      uint64_t prefix = 0;
+
+      /* large problems: rows shared by the team, no barrier between them */
+      for (k=0; k<nb; k++) {
+         if (cost (&p[k]) < split) continue;
+         #pragma omp for schedule(static) nowait
+         for (unsigned i=0; i<p[k].n; i++)
+            solve_row (&p[k], i);
+      }
+
+      /* small problems: each one goes to the thread owning its cost midpoint */
+      for (k=0; k<nb; k++) {
+         const uint64_t w = cost (&p[k]);
+         if (w == 0 || w >= split) continue;
+         if ((prefix + w / 2) * nt / small_total == t) {
+            unsigned i;
+            for (i=0; i<p[k].n; i++)
+               solve_row (&p[k], i);
+         }
+         prefix += w;
+      }
+   }
+}
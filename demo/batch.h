@@ -0,0 +1,22 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+/* Batched kernel for throughput workloads: many small independent problems
+   solved in a single OpenMP parallel region instead of one fork/join per
+   call. Problems at least as large as a thread's share of the batch (and of
+   BATCH_SPLIT_MIN_ELEMS elements) are split by rows over the team, the others
+   are grouped into contiguous runs of about equal cost, one per thread.
+   TODO: adjust for each kernel */
+
+struct kernel_problem {
+   unsigned n;
+   float *a, *b;
+   float *c; /* n x n, row-major */
+};
+
+#define BATCH_SPLIT_MIN_ELEMS (64 * 1024) /* smaller problems are never split */
+
+/* Same result as kernel (p[k].n, p[k].a, p[k].b, p[k].c) for each problem */
+void kernel_batch (unsigned nb, const struct kernel_problem p[]);
+
+#endif
@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <stdlib.h> // qsort
+#include <stdint.h>
+#include <string.h> // memcpy
+#include <math.h>   // ceil
+#include <time.h>   // clock_gettime
+
+#include "bench.h"
+#include "rng.h"
+#include "stats.h"
+
+// TODO: adjust for each kernel
+static void init_arrays (int n, float a[n], float b[n], float c[n][n], int parallel) {
+   rng_fill (n, a, RNG_SEED, 0, parallel);
+   rng_fill (n, b, RNG_SEED, 1, parallel);
+   rng_fill ((size_t) n * n, &c[0][0], RNG_SEED, 2, parallel);
+}
+
+/* Arrays of one bench_run_metas, allocated and initialised once. TODO: adjust for each kernel */
+struct arrays {
+   float *a;  /* kernel output, restored from a0 before each meta (each call in cold mode) */
+   float *b;
+   float *c;  /* size x size */
+   float *a0; /* pristine a */
+};
+
+static void arrays_alloc (struct arrays *arr, const struct protocol *proto) {
+   const unsigned size = proto->size;
+
+   arr->a = placement_alloc_or_exit (proto->placement, size, sizeof arr->a[0]);
+   arr->b = placement_alloc_or_exit (proto->placement, size, sizeof arr->b[0]);
+   arr->c = placement_alloc_or_exit (proto->placement, size, size * sizeof arr->c[0]);
+   arr->a0 = placement_alloc_or_exit (proto->placement, size, sizeof arr->a0[0]);
+
+   init_arrays (size, arr->a, arr->b, (float (*)[size]) arr->c, placement_parallel_init (proto->placement));
+   memcpy (arr->a0, arr->a, size * sizeof arr->a0[0]);
+}
+
+/* Streaming copy: not timed, and b and c stay in the caches */
+static void arrays_restore (const struct arrays *arr, unsigned size) {
+   alloc_stream_copy (arr->a, arr->a0, size * sizeof arr->a[0]);
+}
+
+static void arrays_free (struct arrays *arr, const struct protocol *proto) {
+   const unsigned size = proto->size;
+
+   placement_free (proto->placement, arr->a, size, sizeof arr->a[0]);
+   placement_free (proto->placement, arr->b, size, sizeof arr->b[0]);
+   placement_free (proto->placement, arr->c, size, size * sizeof arr->c[0]);
+   placement_free (proto->placement, arr->a0, size, sizeof arr->a0[0]);
+}
+
+static int cmp_uint64 (const void *a, const void *b) {
+   const uint64_t va = *((uint64_t *) a);
+   const uint64_t vb = *((uint64_t *) b);
+
+   if (va < vb) return -1;
+   if (va > vb) return 1;
+   return 0;
+}
+
+/* Cold caches: each call is timed alone on restored inputs after an
+   eviction, so that the restore and eviction costs are left out of tdiff
+   (and of the counters) */
+static void run_cold (struct variant_result *res, const struct protocol *proto, unsigned m,
+                      const struct arrays *arr) {
+   const kernel_fn_t kernel = res->kv->fn;
+   const unsigned size = proto->size;
+   const struct timer *timer = proto->timer;
+   float *a = arr->a, *b = arr->b;
+   void *c = arr->c;
+   void *const arrays[] = { a, b, c };
+   const size_t lens[] = { size * sizeof a[0], size * sizeof b[0], (size_t) size * size * sizeof a[0] };
+   uint64_t counts [PERFCTR_MAX];
+   unsigned i, e;
+
+   res->tdiff[m] = 0;
+   res->tevict[m] = 0;
+   for (e=0; e<PERFCTR_MAX; e++) res->counts[m][e] = 0;
+
+   for (i=0; i<proto->repm; i++) {
+      arrays_restore (arr, size);
+      const uint64_t t0 = timer->start();
+      evict (proto->evict, 3, arrays, lens);
+      const uint64_t t1 = timer->stop();
+      res->tevict[m] += timer_elapsed (timer, t0, t1);
+
+      if (proto->pc != NULL) perfctr_start (proto->pc);
+      const uint64_t t2 = timer->start();
+      kernel (size, a, b, c);
+      const uint64_t t3 = timer->stop();
+      if (proto->pc != NULL) {
+         perfctr_stop (proto->pc, counts);
+         for (e=0; e<proto->pc->nb_events; e++) res->counts[m][e] += counts[e];
+      }
+      res->tdiff[m] += timer_elapsed (timer, t2, t3);
+   }
+}
+
+static void run_meta (struct variant_result *res, const struct protocol *proto, unsigned m,
+                      const struct arrays *arr) {
+   const kernel_fn_t kernel = res->kv->fn;
+   const unsigned size = proto->size;
+   const unsigned repm = proto->repm;
+   const struct timer *timer = proto->timer;
+   float *a = arr->a, *b = arr->b;
+   float (*c)[size] = (float (*)[size]) arr->c;
+   unsigned i;
+
+   if (!proto->quiet)
+      printf ("[%s] Metarepetition %u/%u: running %u warmup instances and %u measure instances\n",
+              res->kv->name, m+1, proto->nb_metas, m == 0 ? proto->repw : 1, repm);
+
+   if (proto->placement != NULL) placement_pin_threads (proto->placement);
+
+   /* same inputs for every meta: the repm calls of a meta accumulate into a */
+   arrays_restore (arr, size);
+
+   /* warmup (repw repetitions in first meta, 1 repet in next metas) */
+   if (m == 0) {
+      for (i=0; i<proto->repw; i++)
+         kernel (size, a, b, c);
+   } else {
+      kernel (size, a, b, c);
+   }
+
+   if (proto->evict != NULL) {
+      run_cold (res, proto, m, arr);
+   } else {
+      /* measure repm repetitions, energy read outside the timed region */
+      uint64_t uj0 [ENERGY_MAX_DOMAINS], uj1 [ENERGY_MAX_DOMAINS];
+      const int energy = res->joules != NULL && energy_read (proto->energy, uj0) == 0;
+      if (proto->pc != NULL) perfctr_start (proto->pc);
+      const uint64_t t1 = timer->start();
+      for (i=0; i<repm; i++) {
+         kernel (size, a, b, c);
+      }
+      const uint64_t t2 = timer->stop();
+      if (proto->pc != NULL) perfctr_stop (proto->pc, res->counts[m]);
+      res->tdiff[m] = timer_elapsed (timer, t1, t2);
+      if (res->joules != NULL) {
+         unsigned d;
+         const int ok = energy && energy_read (proto->energy, uj1) == 0;
+         for (d=0; d<proto->energy->nb_domains; d++)
+            res->joules[m][d] = ok ? energy_joules (proto->energy, d, uj0[d], uj1[d]) : NAN;
+      }
+   }
+}
+
+void bench_update_stats (struct variant_result *res) {
+   const unsigned n = res->nb_metas;
+   uint64_t *sorted = malloc (n * sizeof sorted[0]);
+   double *x = malloc (n * sizeof x[0]);
+
+   memcpy (sorted, res->tdiff, n * sizeof sorted[0]);
+   qsort (sorted, n, sizeof sorted[0], cmp_uint64);
+   res->min = sorted[0];
+   res->med = sorted[n/2];
+   res->stab = res->min > 0 ? (res->med - res->min) * 100.0f / res->min : 0.0f;
+
+   stats_from_uint64 (res->tdiff, n, x);
+   stats_bootstrap_median_ci (x, n, STATS_NB_RESAMPLES, CI_LEVEL, &res->ci_lo, &res->ci_hi);
+   res->nb_outliers = stats_mad_outliers (x, n, STATS_MAD_THRESHOLD, NULL);
+
+   if (res->tevict != NULL) {
+      memcpy (sorted, res->tevict, n * sizeof sorted[0]);
+      qsort (sorted, n, sizeof sorted[0], cmp_uint64);
+      res->evict_med = sorted[n/2];
+   }
+
+   free (sorted);
+   free (x);
+}
+
+double bench_ci_width (const struct variant_result *res) {
+   return res->med > 0 ? (res->ci_hi - res->ci_lo) / res->med : 0.0;
+}
+
+static double wall_seconds (void) {
+   struct timespec ts;
+   clock_gettime (CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Room for proto->nb_metas samples, previous ones released */
+static void alloc_samples (struct variant_result *res, const struct protocol *proto) {
+   bench_free (res);
+   res->tdiff = malloc (proto->nb_metas * sizeof res->tdiff[0]);
+   res->counts = malloc (proto->nb_metas * sizeof res->counts[0]);
+   if (proto->evict != NULL)
+      res->tevict = malloc (proto->nb_metas * sizeof res->tevict[0]);
+   else if (proto->energy != NULL && proto->energy->nb_domains > 0)
+      res->joules = malloc (proto->nb_metas * sizeof res->joules[0]);
+   res->stop_reason = NULL;
+}
+
+void bench_run_metas (struct variant_result *res, const struct protocol *proto) {
+   const double start = wall_seconds();
+   struct arrays arr;
+   unsigned m;
+
+   alloc_samples (res, proto);
+
+   /* allocation and initialisation left out of the metas */
+   if (proto->placement != NULL) placement_pin_threads (proto->placement);
+   arrays_alloc (&arr, proto);
+
+   for (m=0; m<proto->nb_metas; m++) {
+      run_meta (res, proto, m, &arr);
+      res->nb_metas = m+1;
+
+      if (proto->target_ci <= 0 || res->nb_metas < proto->min_metas) continue;
+      bench_update_stats (res);
+      if (bench_ci_width (res) <= proto->target_ci) {
+         res->stop_reason = "target CI width reached";
+         break;
+      }
+      if (wall_seconds() - start >= proto->budget) {
+         res->stop_reason = "time budget exhausted";
+         break;
+      }
+   }
+   if (proto->target_ci > 0 && res->stop_reason == NULL)
+      res->stop_reason = "max number of metas reached";
+
+   arrays_free (&arr, proto);
+   bench_update_stats (res);
+}
+
+/* xorshift64*: order of the variants in each round */
+static uint64_t next_order (uint64_t *state) {
+   *state ^= *state >> 12;
+   *state ^= *state << 25;
+   *state ^= *state >> 27;
+   return *state * 2685821657736338717ULL;
+}
+
+void bench_run_interleaved (struct variant_result res[], unsigned nb, const struct protocol *proto,
+                            uint64_t seed) {
+   const double start = wall_seconds();
+   uint64_t state = seed != 0 ? seed : 1;
+   unsigned order [nb];
+   struct arrays arr;
+   unsigned m, v;
+
+   for (v=0; v<nb; v++)
+      alloc_samples (&res[v], proto);
+
+   /* shared by all variants: same inputs, restored before each meta */
+   if (proto->placement != NULL) placement_pin_threads (proto->placement);
+   arrays_alloc (&arr, proto);
+
+   const char *stop_reason = NULL;
+   for (m=0; m<proto->nb_metas; m++) {
+      /* Fisher-Yates shuffle of the round */
+      for (v=0; v<nb; v++) order[v] = v;
+      for (v=nb-1; v>0; v--) {
+         const unsigned k = next_order (&state) % (v+1);
+         const unsigned tmp = order[v];
+         order[v] = order[k];
+         order[k] = tmp;
+      }
+      for (v=0; v<nb; v++) {
+         run_meta (&res [order[v]], proto, m, &arr);
+         res [order[v]].nb_metas = m+1;
+      }
+
+      if (proto->target_ci <= 0 || m+1 < proto->min_metas) continue;
+      unsigned nb_reached = 0;
+      for (v=0; v<nb; v++) {
+         bench_update_stats (&res[v]);
+         if (bench_ci_width (&res[v]) <= proto->target_ci) nb_reached++;
+      }
+      if (nb_reached == nb) {
+         stop_reason = "target CI width reached by every variant";
+         break;
+      }
+      if (wall_seconds() - start >= nb * proto->budget) {
+         stop_reason = "time budget exhausted";
+         break;
+      }
+   }
+   if (proto->target_ci > 0 && stop_reason == NULL)
+      stop_reason = "max number of metas reached";
+
+   arrays_free (&arr, proto);
+   for (v=0; v<nb; v++) {
+      res[v].stop_reason = stop_reason;
+      bench_update_stats (&res[v]);
+   }
+}
+
+unsigned bench_auto_repm (const struct kernel_variant *kv, const struct protocol *proto,
+                          double meta_seconds) {
+   const unsigned size = proto->size;
+   const struct timer *timer = proto->timer;
+   unsigned i;
+
+   if (proto->placement != NULL) placement_pin_threads (proto->placement);
+   float *a = placement_alloc_or_exit (proto->placement, size, sizeof a[0]);
+   float *b = placement_alloc_or_exit (proto->placement, size, sizeof b[0]);
+   float (*c)[size] = placement_alloc_or_exit (proto->placement, size, size * sizeof c[0][0]);
+   init_arrays (size, a, b, c, placement_parallel_init (proto->placement));
+
+   for (i=0; i<proto->repw; i++)
+      kv->fn (size, a, b, c);
+   const uint64_t t1 = timer->start();
+   kv->fn (size, a, b, c);
+   const uint64_t t2 = timer->stop();
+
+   placement_free (proto->placement, a, size, sizeof a[0]);
+   placement_free (proto->placement, b, size, sizeof b[0]);
+   placement_free (proto->placement, c, size, size * sizeof c[0][0]);
+
+   double meta_ns = meta_seconds * 1e9;
+   if (meta_ns < 2000 * timer->resolution_ns) meta_ns = 2000 * timer->resolution_ns;
+   const double call_ns = timer_ns (timer, timer_elapsed (timer, t1, t2));
+
+   return call_ns > 0 ? (unsigned) ceil (meta_ns / call_ns) : 1;
+}
+
+void bench_free (struct variant_result *res) {
+   free (res->tdiff);
+   free (res->counts);
+   free (res->tevict);
+   free (res->joules);
+   res->tdiff = NULL;
+   res->counts = NULL;
+   res->tevict = NULL;
+   res->joules = NULL;
+   res->nb_metas = 0;
+}
@@ -0,0 +1,77 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#include "energy.h"
+#include "evict.h"
+#include "kernels.h"
+#include "perfctr.h"
+#include "placement.h"
+#include "timer.h"
+
+/* Meta-repetition protocol of the measure driver, shared by its modes */
+
+/* Measurement protocol shared by all variants */
+struct protocol {
+   unsigned size, repw, repm;
+   const struct timer *timer;
+   struct perfctr *pc;   /* NULL: no counters */
+   unsigned nb_metas;    /* fixed count, or upper bound in adaptive mode */
+   unsigned min_metas;   /* adaptive mode: metas before the first stop test */
+   double target_ci;     /* adaptive mode: relative width of the median CI to reach, 0: fixed count */
+   double budget;        /* adaptive mode: time budget per variant, in seconds */
+   const struct placement *placement; /* NULL: OS defaults */
+   const struct evictor *evict;       /* NULL: warm caches, else evicted before each timed call */
+   const struct energy *energy;       /* NULL: no energy counters (warm caches only) */
+   int quiet;            /* no per-meta progress lines */
+};
+
+/* Results of one kernel variant over the meta-repetitions */
+struct variant_result {
+   const struct kernel_variant *kv;
+   unsigned nb_metas;   /* metas actually run */
+   uint64_t *tdiff;     /* per meta, in run order */
+   uint64_t (*counts)[PERFCTR_MAX]; /* per meta, in run order */
+   uint64_t *tevict;    /* cold caches: eviction time per meta, excluded from tdiff */
+   double (*joules)[ENERGY_MAX_DOMAINS]; /* per meta and energy domain, NULL without counters,
+                                            NAN for a failed read or an unknown wraparound */
+   uint64_t min, med;
+   float stab;          /* (med-min)/min, in percent */
+   double ci_lo, ci_hi; /* bootstrap confidence interval of the median, in ticks */
+   unsigned nb_outliers;
+   uint64_t evict_med;  /* cold caches: median eviction time per meta */
+   const char *stop_reason; /* adaptive mode */
+};
+
+#define CI_LEVEL 0.95
+
+/* Runs the metas of one variant: a fixed count, or in adaptive mode metas are
+   added until the median CI is narrow enough, the time budget is spent or
+   nb_metas is reached. The arrays are allocated and initialised once, the
+   kernel output is restored from a pristine copy before each meta (each call
+   in cold mode), outside the timed region. Previous samples of res are released */
+void bench_run_metas (struct variant_result *res, const struct protocol *proto);
+
+/* Interleaved mode: rounds of one meta per variant in a random order drawn
+   from seed, so that slow drift of the host (thermal state, neighbours) hits
+   every variant alike and tdiff[m] of two variants can be paired. The
+   variants share the arrays. In adaptive mode rounds are added until every
+   variant reaches the target CI width or nb times the budget is spent */
+void bench_run_interleaved (struct variant_result res[], unsigned nb, const struct protocol *proto,
+                            uint64_t seed);
+
+/* min, med, stab, CI, outliers and eviction cost from the nb_metas samples */
+void bench_update_stats (struct variant_result *res);
+
+/* Width of the median CI relative to the median */
+double bench_ci_width (const struct variant_result *res);
+
+/* Measure repetitions for metas of at least meta_seconds (and 2000 timer
+   resolutions), from one timed call after proto->repw warmup calls */
+unsigned bench_auto_repm (const struct kernel_variant *kv, const struct protocol *proto,
+                          double meta_seconds);
+
+void bench_free (struct variant_result *res);
+
+#endif
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // strcmp
+
+#include "calib_cfg.h"
+
+#define LINE_MAX_LEN 256
+#define NAME_MAX_LEN 64
+
+/* Parses one entry, skipping comments and blank lines. Returns 0 on success */
+static int parse_line (const char *line, char name [NAME_MAX_LEN], unsigned *size,
+                       unsigned *warmup, unsigned *measure) {
+   if (line[0] == '#') return -1;
+
+   return sscanf (line, "%63s %u %u %u", name, size, warmup, measure) == 4 ? 0 : -1;
+}
+
+int calib_cfg_read (const char *path, const char *variant, unsigned size,
+                    unsigned *warmup, unsigned *measure) {
+   char line [LINE_MAX_LEN], name [NAME_MAX_LEN];
+   unsigned s, w, m;
+   int found = -1;
+
+   FILE *fp = fopen (path, "r");
+   if (fp == NULL) return -1;
+
+   /* last entry wins */
+   while (fgets (line, sizeof line, fp) != NULL) {
+      if (parse_line (line, name, &s, &w, &m) != 0) continue;
+      if (s != size || strcmp (name, variant) != 0) continue;
+      *warmup = w;
+      *measure = m;
+      found = 0;
+   }
+
+   fclose (fp);
+
+   return found;
+}
+
+int calib_cfg_write (const char *path, const char *variant, unsigned size,
+                     unsigned warmup, unsigned measure) {
+   char line [LINE_MAX_LEN], name [NAME_MAX_LEN];
+   unsigned s, w, m;
+
+   /* keep other entries, written to a temporary file renamed over path */
+   char *tmp_path = malloc (strlen (path) + 5);
+   sprintf (tmp_path, "%s.tmp", path);
+
+   FILE *out = fopen (tmp_path, "w");
+   if (out == NULL) {
+      fprintf (stderr, "Cannot write to %s\n", tmp_path);
+      free (tmp_path);
+      return -1;
+   }
+   fprintf (out, "# variant size warmup measure (written by calibrate)\n");
+
+   FILE *in = fopen (path, "r");
+   if (in != NULL) {
+      while (fgets (line, sizeof line, in) != NULL) {
+         if (parse_line (line, name, &s, &w, &m) != 0) continue;
+         if (s == size && strcmp (name, variant) == 0) continue;
+         fprintf (out, "%s %u %u %u\n", name, s, w, m);
+      }
+      fclose (in);
+   }
+   fprintf (out, "%s %u %u %u\n", variant, size, warmup, measure);
+
+   const int err = fclose (out) != 0 || rename (tmp_path, path) != 0;
+   if (err) fprintf (stderr, "Cannot write to %s\n", path);
+   free (tmp_path);
+
+   return err ? -1 : 0;
+}
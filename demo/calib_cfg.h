@@ -0,0 +1,17 @@
+#ifndef CALIB_CFG_H
+#define CALIB_CFG_H
+
+/* Warmup and measure repetition counts recommended by ./calibrate, read back
+   by ./measure. One "<variant> <size> <warmup> <measure>" line per entry */
+
+#define CALIB_CFG_DEFAULT "calibrate.cfg"
+
+/* Adds or replaces the entry of (variant, size). Returns -1 on I/O error */
+int calib_cfg_write (const char *path, const char *variant, unsigned size,
+                     unsigned warmup, unsigned measure);
+
+/* Returns 0 and sets warmup/measure if the entry exists, -1 otherwise */
+int calib_cfg_read (const char *path, const char *variant, unsigned size,
+                    unsigned *warmup, unsigned *measure);
+
+#endif
@@ -1,128 +1,785 @@
 #include <stdio.h>
-#include <stdlib.h> // atoi, qsort
+#include <stdlib.h> // atoi, atof, qsort
 #include <stdint.h>
-#include <time.h> // nanosleep
+#include <string.h> // strtok, strcmp, memcpy
+#include <math.h>   // isnan
+#include <time.h> // clock_gettime
+#include <unistd.h> // getopt
 #include <omp.h>
 
+#include "bench.h"
+#include "calib_cfg.h"
+#include "energy.h"
+#include "env.h"
+#include "evict.h"
+#include "incr.h"
+#include "kernels.h"
+#include "noise.h"
+#include "perfctr.h"
+#include "placement.h"
+#include "record.h"
+#include "roof.h"
+#include "scaling.h"
+#include "stats.h"
+#include "sweep.h"
+#include "throughput.h"
+#include "timer.h"
+#include "topo.h"
+#include "tune_cfg.h"
+
 #define NB_METAS 31
-#define CLOCKS_PER_SEC 1000000
+#define NB_METAS_MAX 1000 /* adaptive mode default upper bound */
+#define MIN_METAS 5
+#define DEFAULT_BUDGET 60.0
 
-//extern uint64_t rdtsc ();
+static int cmp_uint64 (const void *a, const void *b) {
+   const uint64_t va = *((uint64_t *) a);
+   const uint64_t vb = *((uint64_t *) b);
 
-// TODO: adjust for each kernel
-extern void kernel (unsigned n, float a[n], float b[n], float c[n][n]);
+   if (va < vb) return -1;
+   if (va > vb) return 1;
+   return 0;
+}
 
-// TODO: adjust for each kernel
-static void init_array_2 (int n, float x[n][n]) {
-   int i, j;
+/* Time per element of the cost model, in core cycles too when the
+   effective frequency is known (ghz > 0) */
+static void print_per_element (double seconds_per_call, const struct kernel_cost *cost, double ghz) {
+   const double ns = seconds_per_call * 1e9 / cost->elems;
 
-   for (i=0; i<n; i++)
-      for (j=0; j<n; j++)
-         x[i][j] = (float) rand() / RAND_MAX;
+   if (ghz > 0)
+      printf ("%.3f ns, %.2f cycles per element", ns, ns * ghz);
+   else
+      printf ("%.3f ns per element", ns);
 }
 
-static void init_array_1 (int n, float a[n]) {
-   int i;
+/* Prints MIN, MED, rates and stability of one variant. Returns -1 if the fastest meta is too short */
+static int print_result (const struct variant_result *res, const struct timer *timer,
+                         unsigned repm, unsigned size, double ghz) {
+   struct kernel_cost cost;
+   kernels_cost (res->kv, size, &cost);
+   printf ("[%s] %u metarepetitions\n", res->kv->name, res->nb_metas);
 
-   for (i=0; i<n; i++)
-         a[i] = (float) rand() / RAND_MAX;
-}
+   // Minimum value: should be at least 2000 times the timer resolution
+   if (timer_ns (timer, res->min) < 2000 * timer->resolution_ns) {
+      fprintf (stderr, "[%s] Time for the fastest metarepet. is less than 2000 timer resolutions (%.0f ns).\n"
+               "Rerun with more measure-repetitions\n", res->kv->name, timer->resolution_ns);
+      return -1;
+   }
+   const double seconds = timer_seconds (timer, res->min);
+   printf ("MIN %.3f seconds (", seconds);
+   print_per_element (seconds / repm, &cost, ghz);
+   printf (")\n");
 
-static int cmp_uint64 (const void *a, const void *b) {
-   const uint64_t va = *((uint64_t *) a);
-   const uint64_t vb = *((uint64_t *) b);
+   // Median value
+   const double med_seconds = timer_seconds (timer, res->med);
+   printf ("MED %.3f seconds (", med_seconds);
+   print_per_element (med_seconds / repm, &cost, ghz);
+   printf (")\n");
+
+   // Rates of the median call from the cost model
+   const double call = med_seconds / repm;
+   printf ("RATE %.3f GFLOP/s, %.3f GB/s effective, arithmetic intensity %.3f flop/byte\n",
+           call > 0 ? cost.flops / call * 1e-9 : 0.0, call > 0 ? cost.bytes / call * 1e-9 : 0.0,
+           cost.flops / cost.bytes);
+
+   // Stability: (med-min)/min
+   if (res->stab >= 10)
+      printf ("BAD STABILITY: %.2f %%\n", res->stab);
+   else if (res->stab >= 5)
+      printf ("AVERAGE STABILITY: %.2f %%\n", res->stab);
+   else
+      printf ("GOOD STABILITY: %.2f %%\n", res->stab);
+
+   // Confidence interval of the median and outliers
+   printf ("MED %.0f%% CI [%.6f, %.6f] seconds (width %.2f %% of median)\n", CI_LEVEL * 100,
+           timer_seconds (timer, res->ci_lo), timer_seconds (timer, res->ci_hi), bench_ci_width (res) * 100);
+   if (res->nb_outliers > 0)
+      printf ("OUTLIERS: %u/%u metarepetitions beyond %.1f MADs from the median\n",
+              res->nb_outliers, res->nb_metas, STATS_MAD_THRESHOLD);
+   if (res->stop_reason != NULL)
+      printf ("ADAPTIVE: stopped after %u metarepetitions, %s\n", res->nb_metas, res->stop_reason);
 
-   if (va < vb) return -1;
-   if (va > vb) return 1;
    return 0;
 }
 
+/* Same min/median/stability treatment as time for each counter */
+static void print_counters (const struct variant_result *res, const struct perfctr *pc,
+                            unsigned repm, unsigned size) {
+   uint64_t *sorted = malloc (res->nb_metas * sizeof sorted[0]);
+   struct kernel_cost cost;
+   unsigned e, m;
+
+   kernels_cost (res->kv, size, &cost);
+   const double nb_elems = cost.elems * repm; /* per meta */
+   printf ("%-18s %16s %16s %9s %14s\n", "COUNTER", "MIN", "MED", "STAB (%)", "MED/element");
+   for (e=0; e<pc->nb_events; e++) {
+      for (m=0; m<res->nb_metas; m++)
+         sorted[m] = res->counts[m][e];
+      qsort (sorted, res->nb_metas, sizeof sorted[0], cmp_uint64);
+
+      const uint64_t min = sorted[0];
+      const uint64_t med = sorted[res->nb_metas/2];
+      printf ("%-18s %16lu %16lu %9.2f %14.4f\n", pc->names[e], min, med,
+              min > 0 ? (med - min) * 100.0f / min : 0.0f, med / nb_elems);
+   }
+   if (pc->software)
+      printf ("(hardware events unavailable, software events reported)\n");
+   if (pc->multiplexed)
+      printf ("(counters were multiplexed, counts are scaled estimates)\n");
+
+   free (sorted);
+}
+
+/* Median energy per meta of each domain, per call and per element */
+static void print_energy (const struct variant_result *res, const struct energy *e,
+                          const struct timer *timer, unsigned repm, unsigned size) {
+   double *x = malloc (res->nb_metas * sizeof x[0]);
+   struct kernel_cost cost;
+   unsigned d, m;
+
+   kernels_cost (res->kv, size, &cost);
+   for (d=0; d<e->nb_domains; d++) {
+      /* failed reads and unknown wraparounds (NAN) left out */
+      unsigned nb = 0;
+      for (m=0; m<res->nb_metas; m++)
+         if (!isnan (res->joules[m][d])) x[nb++] = res->joules[m][d];
+      if (nb == 0) {
+         printf ("ENERGY %-16s no valid sample\n", e->domains[d].name);
+         continue;
+      }
+      const double med = stats_median (x, nb);
+      const double seconds = timer_seconds (timer, res->med);
+      const double per_call = med / repm;
+      printf ("ENERGY %-16s %.6f J per call (%.3f nJ per element), %.1f W", e->domains[d].name, per_call,
+              per_call * 1e9 / cost.elems, seconds > 0 ? med / seconds : 0.0);
+      if (nb < res->nb_metas)
+         printf (", %u/%u metas without valid sample", res->nb_metas - nb, res->nb_metas);
+      printf ("\n");
+   }
+   if (timer_seconds (timer, res->min) < 0.01)
+      printf ("(metas shorter than 10 ms: energy counters update about every millisecond)\n");
+
+   free (x);
+}
+
+/* Side by side table, speedups against the baseline variant */
+static void print_comparison (const struct variant_result res[], unsigned nb,
+                              const struct variant_result *base, const struct timer *timer) {
+   unsigned v;
+
+   printf ("\n%-16s %6s %12s %12s %9s %9s %12s %12s\n", "VARIANT", "METAS", "MIN (s)", "MED (s)",
+           "STAB (%)", "CI (%)", "SPEEDUP MED", "SPEEDUP MIN");
+   for (v=0; v<nb; v++) {
+      printf ("%-16s %6u %12.6f %12.6f %9.2f %9.2f %11.2fx %11.2fx%s\n", res[v].kv->name, res[v].nb_metas,
+              timer_seconds (timer, res[v].min), timer_seconds (timer, res[v].med), res[v].stab,
+              bench_ci_width (&res[v]) * 100,
+              res[v].med > 0 ? (float) base->med / res[v].med : 0.0f,
+              res[v].min > 0 ? (float) base->min / res[v].min : 0.0f,
+              &res[v] == base ? " (baseline)" : "");
+   }
+}
+
+/* Interleaved mode: per round, relative difference of each variant against
+   the baseline meta of the same round, median and its bootstrap CI */
+static void print_paired (const struct variant_result res[], unsigned nb,
+                          const struct variant_result *base) {
+   double *x = malloc (base->nb_metas * sizeof x[0]);
+   unsigned v, m;
+
+   printf ("\nPaired differences against %s over %u interleaved rounds (negative: faster)\n",
+           base->kv->name, base->nb_metas);
+   printf ("%-16s %14s %24s  %s\n", "VARIANT", "MED DIFF (%)", "CI (%)", "VERDICT");
+   for (v=0; v<nb; v++) {
+      if (&res[v] == base) continue;
+      for (m=0; m<base->nb_metas; m++)
+         x[m] = base->tdiff[m] > 0 ? ((double) res[v].tdiff[m] / base->tdiff[m] - 1.0) * 100 : 0.0;
+
+      double lo, hi;
+      const double med = stats_median (x, base->nb_metas);
+      stats_bootstrap_median_ci (x, base->nb_metas, STATS_NB_RESAMPLES, CI_LEVEL, &lo, &hi);
+      printf ("%-16s %14.2f      [%7.2f, %7.2f]  %s\n", res[v].kv->name, med, lo, hi,
+              hi < 0 ? "faster" : lo > 0 ? "slower" : "no significant difference");
+   }
+   printf ("(%.0f%% CI of the median of the per-round differences)\n", CI_LEVEL * 100);
+
+   free (x);
+}
+
+/* Each variant placed on the roofline from its median time per call and
+   its cost model */
+static void print_roofline (const struct variant_result res[], unsigned nb, const struct roofline *r,
+                            const struct timer *timer, unsigned size, unsigned repm) {
+   const struct roof_level *above = NULL;
+   unsigned v;
+
+   printf ("\n");
+   roof_describe (r, stdout);
+   printf ("%-16s %10s %12s %6s %14s %12s %12s %12s\n", "VARIANT", "FLOP/BYTE", "WS (kB)", "LEVEL",
+           "BOUND GFLOP/s", "GFLOP/s", "GB/s", "% OF BOUND");
+   for (v=0; v<nb; v++) {
+      struct kernel_cost cost;
+      const struct roof_level *level;
+      int memory_bound;
+
+      kernels_cost (res[v].kv, size, &cost);
+      const double ai = cost.flops / cost.bytes;
+      const double bound = roof_attainable (r, ai, (uint64_t) cost.bytes, &level, &memory_bound);
+      const double s = timer_seconds (timer, res[v].med) / repm;
+      const double gflops = s > 0 ? cost.flops / s * 1e-9 : 0.0;
+      printf ("%-16s %10.3f %12.0f %6s %9.2f %-4s %12.3f %12.3f %11.1f%%%s\n", res[v].kv->name, ai,
+              cost.bytes / 1e3, level->name, bound, memory_bound ? "mem" : "FP", gflops,
+              s > 0 ? cost.bytes / s * 1e-9 : 0.0, bound > 0 ? gflops / bound * 100 : 0.0,
+              gflops > bound ? " (above the bound)" : "");
+      if (gflops > bound) above = level;
+   }
+   printf ("(BOUND: min(peak, intensity x bandwidth of the level holding the working set),\n"
+           " limited by memory (mem) or floating-point throughput (FP))\n");
+   if (above != NULL)
+      printf ("(above the bound: part of the working set is served by a faster level than %s,\n"
+              " whose bandwidth was measured with half of its capacity)\n", above->name);
+}
+
+/* Warm and cold medians per call side by side, with the eviction cost left out */
+static void print_cold_warm (const struct variant_result warm[], const struct variant_result cold[],
+                             unsigned nb, const struct timer *timer, unsigned repm) {
+   unsigned v;
+
+   printf ("\n%-16s %14s %14s %9s %9s %10s %14s\n", "VARIANT", "WARM MED (s)", "COLD MED (s)",
+           "CI W (%)", "CI C (%)", "COLD/WARM", "EVICT (s)");
+   for (v=0; v<nb; v++) {
+      const double w = timer_seconds (timer, warm[v].med) / repm;
+      const double c = timer_seconds (timer, cold[v].med) / repm;
+      printf ("%-16s %14.9f %14.9f %9.2f %9.2f %9.2fx %14.9f\n", warm[v].kv->name, w, c,
+              bench_ci_width (&warm[v]) * 100, bench_ci_width (&cold[v]) * 100,
+              w > 0 ? c / w : 0.0, timer_seconds (timer, cold[v].evict_med) / repm);
+   }
+   printf ("(seconds per call; EVICT: median eviction cost per call, excluded from COLD)\n");
+}
+
+static void usage (const char *prog) {
+   fprintf (stderr, "Usage: %s [-l] [-p <plugin.so>]... [-k <variant>[,<variant>...]] [-b <baseline>] [-i <isa>] [-u <tune file>]"
+            " [-t <timer>] [-e] [-n <nb metas>] [-a <target CI %%> [-T <budget s>]] [-c <config file>]"
+            " [-s <min>:<max>:<count>[:lin|geom]] [-P <threads>] [-A <pinning>] [-M <memory>] [-m <allocation>] [-C sweep|flush] [-D <max dirty fraction>] [-B <batch size>[,<batch size>...]] [-R <roofline file>] [-o <record>] [-X <cpus>] [-N <nice>|fifo] [-I] [-H] <size> [<nb warmup repets> <nb measure repets>]\n", prog);
+   fprintf (stderr, "  -l  list available kernel variants and exit\n"
+            "  -p  load a kernel variant from a shared object exporting \"kernel\" (repeatable)\n"
+            "  -k  variants to run (default: %s and loaded plugins)\n"
+            "  -b  baseline variant for speedups (default: first variant)\n"
+            "  -u  also run the variant tuned by ./tune for this CPU model and size bucket\n"
+            "  -i  bind the SIMD variant to avx512, avx2 or sse2 (default: widest supported)\n"
+            "  -e  read performance counters around each measure (perf_event_open)\n"
+            "  -n  number of metarepetitions (default: %d), upper bound with -a (default: %d)\n"
+            "  -a  adaptive mode: add metarepetitions until the %.0f%% CI of the median is narrower\n"
+            "      than this percentage of the median\n"
+            "  -T  adaptive mode time budget per variant in seconds (default: %.0f)\n"
+            "  -c  calibrate results used when repetitions are not given (default: %s)\n"
+            "  -s  size sweep, CSV on stdout (no positional arguments): sizes from min to max,\n"
+            "      geometric (default) or linear spacing, annotated with the cache levels\n"
+            "  -P  thread scaling study over \"all\", \"<first>-<last>\" or \"<n>,<n>...\" threads,\n"
+            "      one OpenMP place per core with OMP_PROC_BIND=close\n"
+            "  -A  thread pinning: none (default), compact or scatter over packages\n"
+            "  -M  array placement: default (serial init), firsttouch (static row partition\n"
+            "      of the kernel), interleave over NUMA nodes or bind:<node>\n"
+            "  -m  array allocation: malloc (default), align64, page, thp (2 MB aligned,\n"
+            "      madvise MADV_HUGEPAGE) or hugetlb (MAP_HUGETLB 2 MB pages, falls back to thp)\n"
+            "  -C  cold caches: evict before each timed call, with a sweep over twice the\n"
+            "      last-level cache or clflushopt over the arrays; eviction is not timed.\n"
+            "      Cold and warm results side by side (sweep and scaling: cold only)\n"
+            "  -D  incremental mode: repeated calls of the cached row-sum context with a random\n"
+            "      fraction (up to this value) of the rows modified before each call, binned by\n"
+            "      dirty fraction against full calls of the selected variants\n"
+            "  -B  throughput mode: problems per second of the batched kernel (one parallel\n"
+            "      region per batch) against one call of each variant per problem, for each\n"
+            "      batch size; repetitions are adjusted to %.0f ms per meta, -a and -T apply per point\n"
+            "  -R  place each result on the roofline of this host: peak FP throughput and\n"
+            "      copy/triad bandwidth of each cache level and DRAM, measured once per CPU\n"
+            "      model and thread count and cached in the given file (e.g. %s)\n"
+            "  -o  result record with every metarepetition sample and the environment fingerprint,\n"
+            "      JSON or CSV if the name ends in .csv, for ./compare (not with -s, -P, -B or -D)\n"
+            "  -X  pin the process on these CPUs (\"2\", \"2-5,8\") with sched_setaffinity\n"
+            "  -N  raise the scheduling priority: nice value (e.g. -10) or fifo (SCHED_FIFO);\n"
+            "      governor, turbo, load, isolated CPUs, SMT and the effective frequency are\n"
+            "      checked in any case and reported next to the results\n"
+            "  -I  interleaved mode: rounds of one metarepetition per variant in a random order,\n"
+            "      paired differences against the baseline with their CI\n"
+            "  -H  scaling study and pinning: also use SMT siblings\n"
+            "  Package and DRAM energy (powercap intel-rapl) is read around each metarepetition when\n"
+            "  readable; %s redirects the sysfs root (default %s)\n"
+            "  -t  timing backend (default: %s), among:\n",
+            kernels_default()->name, NB_METAS, NB_METAS_MAX, CI_LEVEL * 100, DEFAULT_BUDGET,
+            CALIB_CFG_DEFAULT, THROUGHPUT_META_SECONDS * 1e3, ROOF_CFG_DEFAULT, ENERGY_ROOT_ENV,
+            ENERGY_ROOT_DEFAULT, TIMER_DEFAULT);
+   timer_list (stderr);
+}
+
 int main (int argc, char *argv[]) {
+   const char *variant_list = NULL;
+   const char *baseline_name = NULL;
+   const char *isa = NULL;
+   const char *tune_path = NULL;
+   const char *timer_name = TIMER_DEFAULT;
+   const char *cfg_path = CALIB_CFG_DEFAULT;
+   const char *sweep_str = NULL;
+   const char *scaling_str = NULL;
+   double max_dirty = 0.0;
+   const char *batch_str = NULL;
+   const char *roof_path = NULL;
+   const char *record_path = NULL;
+   const char *pin_cpus = NULL;
+   const char *priority = NULL;
+   int smt = 0;
+   static struct placement placement = { .pin = PIN_NONE, .mem = MEM_DEFAULT, .alloc = ALLOC_MALLOC };
+   int cold = 0;
+   enum evict_method evict_method = EVICT_SWEEP;
+   int list_only = 0;
+   int use_counters = 0;
+   int interleave = 0;
+   unsigned nb_metas = 0;
+   double target_ci = 0.0;
+   double budget = DEFAULT_BUDGET;
+   unsigned v;
+
+   /* check command line options */
+   int opt;
+   while ((opt = getopt (argc, argv, "lp:k:b:i:u:t:en:a:T:c:s:P:A:M:m:C:D:B:R:o:X:N:IH")) != -1) {
+      switch (opt) {
+      case 'l': list_only = 1; break;
+      case 'p':
+         if (kernels_load_plugin (optarg) == NULL) return EXIT_FAILURE;
+         break;
+      case 'k': variant_list = optarg; break;
+      case 'b': baseline_name = optarg; break;
+      case 'i': isa = optarg; break;
+      case 'u': tune_path = optarg; break;
+      case 't': timer_name = optarg; break;
+      case 'e': use_counters = 1; break;
+      case 'n': nb_metas = atoi (optarg); break;
+      case 'a': target_ci = atof (optarg) / 100; break;
+      case 'T': budget = atof (optarg); break;
+      case 'c': cfg_path = optarg; break;
+      case 's': sweep_str = optarg; break;
+      case 'P': scaling_str = optarg; break;
+      case 'H': smt = 1; break;
+      case 'I': interleave = 1; break;
+      case 'A':
+         if (placement_parse_pin (optarg, &placement) != 0) {
+            usage (argv[0]);
+            return EXIT_FAILURE;
+         }
+         break;
+      case 'M':
+         if (placement_parse_mem (optarg, &placement) != 0) {
+            usage (argv[0]);
+            return EXIT_FAILURE;
+         }
+         break;
+      case 'C':
+         if (evict_parse (optarg, &evict_method) != 0) {
+            usage (argv[0]);
+            return EXIT_FAILURE;
+         }
+         cold = 1;
+         break;
+      case 'B': batch_str = optarg; break;
+      case 'R': roof_path = optarg; break;
+      case 'o': record_path = optarg; break;
+      case 'X': pin_cpus = optarg; break;
+      case 'N': priority = optarg; break;
+      case 'D':
+         if (incr_parse (optarg, &max_dirty) != 0) {
+            usage (argv[0]);
+            return EXIT_FAILURE;
+         }
+         break;
+      case 'm':
+         if (alloc_parse (optarg, &placement.alloc) != 0) {
+            usage (argv[0]);
+            return EXIT_FAILURE;
+         }
+         break;
+      default:
+         usage (argv[0]);
+         return EXIT_FAILURE;
+      }
+   }
+
+   if (kernels_select_isa (isa) != 0) return EXIT_FAILURE;
+
+   /* before any OpenMP thread is created, so that they inherit the affinity */
+   static struct noise_report noise;
+   if (pin_cpus != NULL && noise_pin (&noise, pin_cpus) != 0) {
+      usage (argv[0]);
+      return EXIT_FAILURE;
+   }
+   if (priority != NULL && noise_priority (&noise, priority) != 0) {
+      usage (argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   if (list_only) {
+      for (v=0; v<kernels_count(); v++) {
+         const struct kernel_variant *kv = kernels_get (v);
+         printf ("%s%s", kv->name, kv->handle != NULL ? " (plugin)" :
+                 kv == kernels_default() ? " (default)" : "");
+         if (strcmp (kv->name, "SIMD") == 0)
+            printf (" (bound to %s)", kernels_selected_isa());
+         if (!kernels_supported (kv))
+            printf (" (needs %s, unsupported)", kv->isa);
+         printf ("\n");
+      }
+      return EXIT_SUCCESS;
+   }
+
    /* check command line arguments */
-   if (argc != 4) {
-      fprintf (stderr, "Usage: %s <size> <nb warmup repets> <nb measure repets>\n", argv[0]);
+   struct sweep_spec sweep;
+   if (sweep_str != NULL) {
+      if (sweep_parse (sweep_str, &sweep) != 0 || argc != optind) {
+         usage (argv[0]);
+         return EXIT_FAILURE;
+      }
+   } else if (argc - optind != 3 && argc - optind != 1) {
+      usage (argv[0]);
       return EXIT_FAILURE;
    }
+   static unsigned batch_sizes [THROUGHPUT_MAX_POINTS];
+   unsigned nb_batch_sizes = 0;
+   if (batch_str != NULL) {
+      nb_batch_sizes = throughput_parse (batch_str, batch_sizes);
+      if (nb_batch_sizes == 0) {
+         usage (argv[0]);
+         return EXIT_FAILURE;
+      }
+   }
+   /* records are only written by the default mode */
+   if (record_path != NULL && (sweep_str != NULL || scaling_str != NULL || batch_str != NULL || max_dirty > 0)) {
+      fprintf (stderr, "-o is not available with -s, -P, -B or -D\n");
+      usage (argv[0]);
+      return EXIT_FAILURE;
+   }
+   /* CSV output on stdout in sweep mode */
+   FILE *info = sweep_str != NULL ? stderr : stdout;
 
-   /* get command line arguments */
-   const unsigned size = atoi (argv[1]); /* problem size */
-   const unsigned repw = atoi (argv[2]); /* number of warmup repetitions */
-   const unsigned repm = atoi (argv[3]); /* number of repetitions during measurement */
+   /* before any OpenMP call: may re-execute the program */
+   static unsigned threads [SCALING_MAX_POINTS];
+   unsigned nb_threads = 0;
+   if (scaling_str != NULL) {
+      const unsigned nb_places = scaling_setup_env (argv, smt);
+      if (nb_places == 0) return EXIT_FAILURE;
+      nb_threads = scaling_parse (scaling_str, nb_places, threads);
+      if (nb_threads == 0) {
+         usage (argv[0]);
+         return EXIT_FAILURE;
+      }
+   }
 
-   uint64_t tdiff [NB_METAS];
+   /* get command line arguments, repetitions default to the calibrate results */
+   const unsigned size = sweep_str != NULL ? sweep.min : atoi (argv[optind]); /* problem size */
+   unsigned repw = sweep_str != NULL ? SWEEP_WARMUP : 0; /* number of warmup repetitions */
+   unsigned repm = 0; /* number of repetitions during measurement */
+   if (argc - optind == 3) {
+      repw = atoi (argv[optind+1]);
+      repm = atoi (argv[optind+2]);
+   }
 
-   unsigned m;
-   for (m=0; m<NB_METAS; m++) {
-      printf ("Metarepetition %u/%d: running %u warmup instances and %u measure instances\n", m+1, NB_METAS,
-              m == 0 ? repw : 1, repm);
+   /* tuned variant, registered as a plugin before the selection */
+   const struct kernel_variant *tuned = NULL;
+   if (tune_path != NULL) {
+      struct tune_entry te;
+      char cpu [TUNE_NAME_LEN];
+      topo_cpu_model (cpu, sizeof cpu);
+      if (tune_cfg_read (tune_path, cpu, size, &te) != 0) {
+         fprintf (stderr, "No tuned configuration for %s, size bucket %u in %s. Run ./tune %u\n",
+                  cpu, tune_size_bucket (size), tune_path, size);
+         return EXIT_FAILURE;
+      }
+      tuned = kernels_load_plugin (te.object);
+      if (tuned == NULL) return EXIT_FAILURE;
+      fprintf (sweep_str != NULL ? stderr : stdout, "Tuned variant %s: unroll %u, %u accumulators, row block %u,"
+               " schedule(%s, %u), %u threads\n", tuned->name, te.params.unroll, te.params.nb_acc,
+               te.params.row_block, te.params.schedule, te.params.chunk, te.params.threads);
+   }
 
-      unsigned i;
+   /* select variants */
+   static struct variant_result res [KERNELS_MAX];
+   unsigned nb_res = 0;
+   if (variant_list != NULL) {
+      char *list = strdup (variant_list);
+      char *name;
+      for (name = strtok (list, ","); name != NULL; name = strtok (NULL, ",")) {
+         const struct kernel_variant *kv = kernels_find (name);
+         if (kv == NULL) {
+            fprintf (stderr, "Unknown kernel variant %s (use -l to list them)\n", name);
+            free (list);
+            return EXIT_FAILURE;
+         }
+         if (nb_res == KERNELS_MAX) {
+            fprintf (stderr, "Too many variants in -k (at most %d)\n", KERNELS_MAX);
+            free (list);
+            return EXIT_FAILURE;
+         }
+         res[nb_res++].kv = kv;
+      }
+      free (list);
 
-      /* allocate arrays. TODO: adjust for each kernel */
-      float *a = malloc (size * sizeof a[0]);
-      float *b = malloc (size * sizeof b[0]);
-      float (*c)[size] = malloc (size * size * sizeof c[0][0]);
+      /* also run the tuned variant when -k does not name it */
+      if (tuned != NULL) {
+         for (v=0; v<nb_res; v++)
+            if (res[v].kv == tuned) break;
+         if (v == nb_res) {
+            if (nb_res == KERNELS_MAX) {
+               fprintf (stderr, "Too many variants in -k (at most %d with the tuned one)\n", KERNELS_MAX);
+               return EXIT_FAILURE;
+            }
+            res[nb_res++].kv = tuned;
+         }
+      }
+   } else {
+      res[nb_res++].kv = kernels_default();
+      for (v=0; v<kernels_count(); v++)
+         if (kernels_get(v)->handle != NULL)
+            res[nb_res++].kv = kernels_get(v);
+   }
+   if (nb_res == 0) {
+      usage (argv[0]);
+      return EXIT_FAILURE;
+   }
 
-      /* init arrays */
-      srand(0);
-      init_array_1 (size, a);
-      init_array_1 (size, b);
-      init_array_2 (size, c);
+   const struct variant_result *base = &res[0];
+   if (baseline_name != NULL) {
+      for (v=0; v<nb_res; v++)
+         if (strcmp (res[v].kv->name, baseline_name) == 0) break;
+      if (v == nb_res) {
+         fprintf (stderr, "Baseline %s is not among the selected variants\n", baseline_name);
+         return EXIT_FAILURE;
+      }
+      base = &res[v];
+   }
 
-      /* warmup (repw repetitions in first meta, 1 repet in next metas) */
-      if (m == 0) {
-         for (i=0; i<repw; i++)
-            kernel (size, a, b, c);
-      } else {
-         kernel (size, a, b, c);
+   /* same protocol for all variants: largest recommended counts (throughput
+      mode adjusts its own) */
+   if (sweep_str == NULL && batch_str == NULL && argc - optind == 1) {
+      for (v=0; v<nb_res; v++) {
+         unsigned w, m;
+         if (calib_cfg_read (cfg_path, res[v].kv->name, size, &w, &m) != 0) {
+            fprintf (stderr, "No calibration for %s at size %u in %s, run ./calibrate -k %s %u <nb measures>\n"
+                     "or give the number of warmup and measure repetitions\n",
+                     res[v].kv->name, size, cfg_path, res[v].kv->name, size);
+            return EXIT_FAILURE;
+         }
+         if (w > repw) repw = w;
+         if (m > repm) repm = m;
       }
+      fprintf (info, "Using %u warmup and %u measure repetitions from %s\n", repw, repm, cfg_path);
+   }
+
+   placement.smt = smt;
+   if (placement_init (&placement) != 0) return EXIT_FAILURE;
+   placement_describe (&placement, info);
+   fprintf (info, "SIMD variant bound to %s (%s)\n", kernels_selected_isa(), isa != NULL ? "forced" : "cpuid");
+
+   struct timer *timer = timer_find (timer_name);
+   if (timer == NULL) {
+      fprintf (stderr, "Unknown timer %s\n", timer_name);
+      usage (argv[0]);
+      return EXIT_FAILURE;
+   }
+   if (timer_init (timer) != 0) return EXIT_FAILURE;
+   fprintf (info, "Timer %s: %s\n  resolution %.1f ns, overhead %.1f ns\n", timer->name, timer->desc,
+           timer->resolution_ns, timer_ns (timer, timer->overhead));
 
-      /* measure repm repetitions */
-//      const uint64_t t1 = rdtsc();
-      const clock_t t1 = clock();
-      for (i=0; i<repm; i++) {
-         kernel (size, a, b, c);
+   static struct perfctr counters;
+   struct perfctr *pc = NULL;
+   if (use_counters) {
+      if (perfctr_open (&counters) != 0) return EXIT_FAILURE;
+      pc = &counters;
+      fprintf (info, "Counting %s events on %u threads\n", pc->software ? "software" : "hardware",
+              pc->nb_threads);
+   }
+
+   static struct evictor evictor;
+   if (cold) {
+      if (evict_init (&evictor, evict_method) != 0) return EXIT_FAILURE;
+      evict_describe (&evictor, info);
+   }
+
+   if (nb_metas == 0) nb_metas = target_ci > 0 ? NB_METAS_MAX : NB_METAS;
+   struct protocol proto = {
+      .size = size, .repw = repw, .repm = repm, .timer = timer, .pc = pc,
+      .nb_metas = nb_metas, .min_metas = MIN_METAS, .target_ci = target_ci, .budget = budget,
+      .placement = &placement, .quiet = sweep_str != NULL || scaling_str != NULL,
+      .evict = cold && (sweep_str != NULL || scaling_str != NULL) ? &evictor : NULL,
+   };
+
+   /* host findings reported by every mode, on info in sweep mode */
+   noise_check (&noise);
+   noise_frequency (&noise, "at start");
+
+   if (scaling_str != NULL) {
+      scaling_run (res, nb_res, &proto, threads, nb_threads, stdout);
+      noise_frequency (&noise, "after -P");
+      noise_print (&noise, stdout);
+      for (v=0; v<nb_res; v++)
+         bench_free (&res[v]);
+      if (pc != NULL) perfctr_close (pc);
+      evict_free (&evictor);
+      kernels_unload_plugins ();
+      return EXIT_SUCCESS;
+   }
+
+   if (sweep_str != NULL) {
+      sweep_run (res, nb_res, &proto, &sweep, stdout);
+      noise_frequency (&noise, "after -s");
+      noise_print (&noise, info);
+      for (v=0; v<nb_res; v++)
+         bench_free (&res[v]);
+      if (pc != NULL) perfctr_close (pc);
+      evict_free (&evictor);
+      kernels_unload_plugins ();
+      return EXIT_SUCCESS;
+   }
+
+   if (batch_str != NULL) {
+      const int status = throughput_run (res, nb_res, &proto, batch_sizes, nb_batch_sizes, stdout);
+      noise_frequency (&noise, "after -B");
+      noise_print (&noise, stdout);
+      if (pc != NULL) perfctr_close (pc);
+      evict_free (&evictor);
+      kernels_unload_plugins ();
+      return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+   }
+
+   if (max_dirty > 0) {
+      incr_run (res, nb_res, &proto, max_dirty, stdout);
+      noise_frequency (&noise, "after -D");
+      noise_print (&noise, stdout);
+      for (v=0; v<nb_res; v++)
+         bench_free (&res[v]);
+      if (pc != NULL) perfctr_close (pc);
+      evict_free (&evictor);
+      kernels_unload_plugins ();
+      return EXIT_SUCCESS;
+   }
+
+   /* measured once per machine, before the variants */
+   static struct roofline roof;
+   if (roof_path != NULL) {
+      char cpu [TUNE_NAME_LEN];
+      topo_cpu_model (cpu, sizeof cpu);
+      if (roof_cfg_read (roof_path, cpu, omp_get_max_threads(), &roof) != 0) {
+         if (roof_measure (&roof) != 0) return EXIT_FAILURE;
+         roof_cfg_write (roof_path, &roof);
+      } else {
+         printf ("Roofline read from %s\n", roof_path);
       }
+   }
 
-      const clock_t t2 = clock();
-      tdiff[m] = (t2 - t1);
+   /* package and DRAM energy around each meta, when readable */
+   static struct energy energy;
+   if (energy_open (&energy) > 0) {
+      proto.energy = &energy;
+      printf ("Energy counters under %s:", energy.root);
+      for (v=0; v<energy.nb_domains; v++)
+         printf (" %s", energy.domains[v].name);
+      printf ("\n");
+   } else {
+      printf ("Energy counters unavailable: %s\n", energy.status);
+   }
 
-//      const uint64_t t2 = rdtsc();
-//      tdiff[m] = t2 - t1;
+   /* all variants in the same process, under the same protocol; effective
+      frequency after each one for the cycle figures */
+   static double ghz [KERNELS_MAX];
+   struct timespec now;
+   clock_gettime (CLOCK_REALTIME, &now);
+   const uint64_t order_seed = (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+   if (interleave) {
+      printf ("Interleaved rounds, variant order drawn from seed %lu\n", order_seed);
+      bench_run_interleaved (res, nb_res, &proto, order_seed);
+      noise_frequency (&noise, "interleaved");
+      for (v=0; v<nb_res; v++)
+         ghz[v] = noise.ghz;
+   } else {
+      for (v=0; v<nb_res; v++) {
+         char label [32];
+         bench_run_metas (&res[v], &proto);
+         snprintf (label, sizeof label, "after %s", res[v].kv->name);
+         noise_frequency (&noise, label);
+         ghz[v] = noise.ghz;
+      }
+   }
 
-      /* free arrays. TODO: adjust for each kernel */
-      free (a);
-      free (b);
-      free (c);
+   int status = EXIT_SUCCESS;
+   for (v=0; v<nb_res; v++) {
+      if (print_result (&res[v], timer, repm, size, ghz[v]) != 0)
+         status = EXIT_FAILURE;
+      if (pc != NULL)
+         print_counters (&res[v], pc, repm, size);
+      if (res[v].joules != NULL)
+         print_energy (&res[v], &energy, timer, repm, size);
    }
 
-   const unsigned nb_inner_iters = size * size * repm; // TODO adjust for each kernel
-   qsort (tdiff, NB_METAS, sizeof tdiff[0], cmp_uint64);
+   if (nb_res > 1)
+      print_comparison (res, nb_res, base, timer);
+   if (interleave && nb_res > 1)
+      print_paired (res, nb_res, base);
 
-   // Minimum value: should be at least 2000 RDTSC-cycles
-   const uint64_t min = tdiff[0];
-   if (min < 2000) {
-      fprintf (stderr, "Time for the fastest metarepet. is less than 2000 RDTSC-cycles.\n"
-               "Rerun with more measure-repetitions\n");
-      return EXIT_FAILURE;
+   if (roof_path != NULL)
+      print_roofline (res, nb_res, &roof, timer, size, repm);
+
+   /* same protocol again, caches evicted before each call */
+   static struct variant_result cold_res [KERNELS_MAX];
+   if (cold) {
+      proto.evict = &evictor;
+      printf ("\nCold caches\n");
+      for (v=0; v<nb_res; v++)
+         cold_res[v].kv = res[v].kv;
+      /* cycle figures from the frequency of the cold pass itself */
+      if (interleave) {
+         bench_run_interleaved (cold_res, nb_res, &proto, order_seed);
+         noise_frequency (&noise, "cold rounds");
+         for (v=0; v<nb_res; v++)
+            ghz[v] = noise.ghz;
+      } else {
+         for (v=0; v<nb_res; v++) {
+            char label [32];
+            bench_run_metas (&cold_res[v], &proto);
+            snprintf (label, sizeof label, "cold %s", cold_res[v].kv->name);
+            noise_frequency (&noise, label);
+            ghz[v] = noise.ghz;
+         }
+      }
+      for (v=0; v<nb_res; v++) {
+         if (print_result (&cold_res[v], timer, repm, size, ghz[v]) != 0)
+            status = EXIT_FAILURE;
+         if (pc != NULL)
+            print_counters (&cold_res[v], pc, repm, size);
+      }
+      print_cold_warm (res, cold_res, nb_res, timer, repm);
+      if (interleave && nb_res > 1)
+         print_paired (cold_res, nb_res, cold_res + (base - res));
    }
-   const float seconds = (float) min/ (float) CLOCKS_PER_SEC;
-   printf ("MIN %.3f seconds (%.2f per inner-iter per milliseconds)\n",
-           seconds, (seconds * 1000.0)/nb_inner_iters);
 
-   // Median value
-   const uint64_t med = tdiff[NB_METAS/2];
-   printf ("MED %.3ld seconds (%.2f per inner-iter per milliseconds)\n",
-           med, (float) med * 1000 / nb_inner_iters);
+   noise_print (&noise, stdout);
 
-   // Stability: (med-min)/min
-   const float stab = (med - min) * 100.0f / min;
-   if (stab >= 10)
-      printf ("BAD STABILITY: %.2f %%\n", stab);
-   else if (stab >= 5)
-      printf ("AVERAGE STABILITY: %.2f %%\n", stab);
-   else
-      printf ("GOOD STABILITY: %.2f %%\n", stab);
+   /* warm results and, with -C, the cold ones marked as evicted */
+   if (record_path != NULL) {
+      struct env_info env;
+      env_collect (&env);
+      snprintf (env.alloc, sizeof env.alloc, "%s", alloc_name (placement.alloc));
+      placement_fingerprint (&placement, env.placement, sizeof env.placement);
+      snprintf (env.isa, sizeof env.isa, "%s", kernels_selected_isa());
+      if (record_write (record_path, &env, res, cold ? cold_res : NULL, nb_res, &proto) != 0)
+         status = EXIT_FAILURE;
+      else
+         printf ("\nResult record written to %s\n", record_path);
+   }
+
+   for (v=0; v<nb_res; v++) {
+      bench_free (&res[v]);
+      bench_free (&cold_res[v]);
+   }
+   if (pc != NULL) perfctr_close (pc);
+   energy_close (&energy);
+   evict_free (&evictor);
+   kernels_unload_plugins ();
 
-   return EXIT_SUCCESS;
+   return status;
 }
@@ -1,30 +1,28 @@
 #include <stdio.h>
 #include <stdlib.h> // atoi, qsort
 #include <stdint.h>
+#include <string.h> // strcmp
+#include <math.h> // ceil
 #include <time.h> // nanosleep
+#include <unistd.h> // getopt
 #include <omp.h>
 
-#define NB_METAS 5
-
-//extern uint64_t rdtsc ();
+#include "calib_cfg.h"
+#include "hist.h"
+#include "kernels.h"
+#include "placement.h"
+#include "rng.h"
+#include "stats.h"
+#include "timer.h"
 
-// TODO: adjust for each kernel
-extern void kernel (unsigned n, float a[n], float b[n][n], float c[n][n]);
+#define NB_METAS 5
+#define MIN_META_SECONDS 0.01 /* recommended duration of a measure meta-repetition */
 
 // TODO: adjust for each kernel
-static void init_array_2 (int n, float a[n][n]) {
-   int i, j;
-
-   for (i=0; i<n; i++)
-      for (j=0; j<n; j++)
-         a[i][j] = (float) rand() / RAND_MAX;
-}
-
-static void init_array_1 (int n, float a[n]) {
-   int i;
-
-   for (i=0; i<n; i++)
-         a[i] = (float) rand() / RAND_MAX;
+static void init_arrays (int n, float a[n], float b[n], float c[n][n], int parallel) {
+   rng_fill (n, a, RNG_SEED, 0, parallel);
+   rng_fill (n, b, RNG_SEED, 1, parallel);
+   rng_fill ((size_t) n * n, &c[0][0], RNG_SEED, 2, parallel);
 }
 
 static int cmp_uint64 (const void *a, const void *b) {
@@ -36,23 +34,91 @@ static int cmp_uint64 (const void *a, const void *b) {
    return 0;
 }
 
+static void usage (const char *prog) {
+   fprintf (stderr, "Usage: %s [-k <variant>] [-i <isa>] [-c <config file>] [-n <nb metas>] [-t <timer>]"
+            " [-L <nb calls>] [-H <histogram file>] <size> <nb measures>\n", prog);
+   fprintf (stderr, "  -k  kernel variant to calibrate (default: %s)\n", kernels_default()->name);
+   fprintf (stderr, "  -i  bind the SIMD variant to avx512, avx2 or sse2 (default: widest supported)\n");
+   fprintf (stderr, "  -c  file receiving the recommended warmup and measure repetitions (default: %s)\n",
+            CALIB_CFG_DEFAULT);
+   fprintf (stderr, "  -n  number of metarepetitions (default: %d)\n", NB_METAS);
+   fprintf (stderr, "  -L  after calibration, time this many more calls after the recommended warmup\n"
+            "      (latency histogram only, constant memory)\n");
+   fprintf (stderr, "  -H  export the latency histogram of every call as CSV\n");
+   fprintf (stderr, "  -t  timing backend (default: %s), among:\n", TIMER_DEFAULT);
+   timer_list (stderr);
+}
+
 int main (int argc, char *argv[]) {
+   const char *timer_name = TIMER_DEFAULT;
+   const char *cfg_path = CALIB_CFG_DEFAULT;
+   const struct kernel_variant *kv = kernels_default();
+   const char *isa = NULL;
+   unsigned nb_metas = NB_METAS;
+   unsigned nb_latency = 0;
+   const char *hist_path = NULL;
+
+   /* check command line options */
+   int opt;
+   while ((opt = getopt (argc, argv, "k:i:c:n:t:L:H:")) != -1) {
+      switch (opt) {
+      case 'k':
+         kv = kernels_find (optarg);
+         if (kv == NULL) {
+            fprintf (stderr, "Unknown kernel variant %s\n", optarg);
+            return EXIT_FAILURE;
+         }
+         break;
+      case 'i': isa = optarg; break;
+      case 'c': cfg_path = optarg; break;
+      case 'n': nb_metas = atoi (optarg); break;
+      case 't': timer_name = optarg; break;
+      case 'L': nb_latency = atoi (optarg); break;
+      case 'H': hist_path = optarg; break;
+      default:
+         usage (argv[0]);
+         return EXIT_FAILURE;
+      }
+   }
+
+   if (kernels_select_isa (isa) != 0) return EXIT_FAILURE;
 
    /* check command line arguments */
-   if (argc != 3) {
-      fprintf (stderr, "Usage: %s <size> <nb measures>\n", argv[0]);
+   if (argc - optind != 2 || nb_metas == 0) {
+      usage (argv[0]);
       return EXIT_FAILURE;
    }
 
    /* get command line arguments */
-   const unsigned size = atoi (argv[1]); /* problem size */
-   const unsigned repm = atoi (argv[2]); /* number of repetitions during measurement */
+   const unsigned size = atoi (argv[optind]);   /* problem size */
+   const unsigned repm = atoi (argv[optind+1]); /* number of repetitions during measurement */
 
-   uint64_t (*tdiff)[NB_METAS] = malloc (repm * sizeof tdiff[0]);
+   struct timer *timer = timer_find (timer_name);
+   if (timer == NULL) {
+      fprintf (stderr, "Unknown timer %s\n", timer_name);
+      usage (argv[0]);
+      return EXIT_FAILURE;
+   }
+   if (timer_init (timer) != 0) return EXIT_FAILURE;
+   printf ("Timer %s: %s\n  resolution %.1f ns, overhead %.1f ns\n", timer->name, timer->desc,
+           timer->resolution_ns, timer_ns (timer, timer->overhead));
+
+   const kernel_fn_t kernel = kv->fn;
+   if (strcmp (kv->name, "SIMD") == 0)
+      printf ("Calibrating %s (%s)\n", kv->name, kernels_selected_isa());
+   else
+      printf ("Calibrating %s\n", kv->name);
+
+   const int parallel = placement_parallel_init (NULL); /* serial init on NUMA hosts, as measure */
+   uint64_t (*tdiff)[nb_metas] = malloc (repm * sizeof tdiff[0]);
+   double *x = malloc (nb_metas * sizeof x[0]);
+   double *series = malloc (repm * sizeof series[0]); /* per-instance medians */
+   static struct hist latency; /* every call, including the -L ones */
+   hist_init (&latency);
 
    unsigned m;
-   for (m=0; m<NB_METAS; m++) {
-      printf ("Metarepetition %u/%d: running %u instances\n", m+1, NB_METAS, repm);
+   for (m=0; m<nb_metas; m++) {
+      printf ("Metarepetition %u/%u: running %u instances\n", m+1, nb_metas, repm);
 
       unsigned i;
 
@@ -62,19 +128,15 @@ int main (int argc, char *argv[]) {
       float (*c)[size] = malloc (size * size * sizeof c[0][0]);
 
       /* init arrays */
-      srand(0);
-      init_array_1 (size, a);
-      init_array_1 (size, b);
-      init_array_2 (size, c);
+      init_arrays (size, a, b, c, parallel);
 
       // No warmup, measure individual instances
       for (i=0; i<repm; i++) {
-         //const uint64_t t1 = rdtsc();
-         const clock_t t1 = clock();
+         const uint64_t t1 = timer->start();
          kernel (size, a, b, c);
-         //const uint64_t t2 = rdtsc();
-         const clock_t t2 = clock();
-         tdiff[i][m] = t2 - t1;
+         const uint64_t t2 = timer->stop();
+         tdiff[i][m] = timer_elapsed (timer, t1, t2);
+         hist_record (&latency, tdiff[i][m]);
       }
 
       /* free arrays. TODO: adjust for each kernel */
@@ -87,26 +149,27 @@ int main (int argc, char *argv[]) {
       nanosleep (&two_seconds, NULL);
    }
 
-   const unsigned nb_inner_iters = size * size * repm; // TODO adjust for each kernel
+   struct kernel_cost cost;
+   kernels_cost (kv, size, &cost);
    int i;
    for (i=0; i<repm; i++) {
       printf ("Instance %u/%u\n", i+1, repm);
 
-      qsort (tdiff[i], NB_METAS, sizeof tdiff[i][0], cmp_uint64);
+      stats_from_uint64 (tdiff[i], nb_metas, x);
+      series[i] = stats_median (x, nb_metas);
+      qsort (tdiff[i], nb_metas, sizeof tdiff[i][0], cmp_uint64);
 
-      // Minimum value: should be at least 2000 seconds
-      const float min = (float)(tdiff[i][0])/ (float) CLOCKS_PER_SEC;
+      // Minimum value
+      const float min = timer_seconds (timer, tdiff[i][0]);
 
-      printf ("MIN %.3f seconds (%.2f per inner-iter per milliseconds)\n",
-              min, (float) min * 1000 / nb_inner_iters);
+      printf ("MIN %.6f seconds (%.3f ns per element)\n", min, min * 1e9 / cost.elems);
 
-      // Median value
-      const uint64_t med = tdiff[i][NB_METAS/2];
-      if (med < 500) {
-         printf ("Warning: median time is less than 500 seconds. Accurary is limited for that instance\n");
+      // Median value: should be at least 500 times the timer resolution
+      const float med = timer_seconds (timer, tdiff[i][nb_metas/2]);
+      if (timer_ns (timer, tdiff[i][nb_metas/2]) < 500 * timer->resolution_ns) {
+         printf ("Warning: median time is less than 500 timer resolutions. Accurary is limited for that instance\n");
       }
-      printf ("MED %.3ld seconds (%.2f per inner-iter per milliseconds)\n",
-              med, (float) med * 1000 / nb_inner_iters);
+      printf ("MED %.6f seconds (%.3f ns per element)\n", med, med * 1e9 / cost.elems);
 
       // Stability: (med-min)/min
       const float stab = (med - min) * 100.0f / min;
@@ -116,7 +179,76 @@ int main (int argc, char *argv[]) {
          printf ("AVERAGE STABILITY: %.2f %%\n", stab);
       else
          printf ("GOOD STABILITY: %.2f %%\n", stab);
+
+      // Confidence interval of the median and outliers across metarepetitions
+      double lo, hi;
+      stats_bootstrap_median_ci (x, nb_metas, STATS_NB_RESAMPLES, 0.95, &lo, &hi);
+      printf ("MED 95%% CI [%.6f, %.6f] seconds\n", timer_seconds (timer, lo), timer_seconds (timer, hi));
+      const unsigned nb_outliers = stats_mad_outliers (x, nb_metas, STATS_MAD_THRESHOLD, NULL);
+      if (nb_outliers > 0)
+         printf ("OUTLIERS: %u/%u metarepetitions beyond %.1f MADs from the median\n",
+                 nb_outliers, nb_metas, STATS_MAD_THRESHOLD);
    }
 
-   return EXIT_SUCCESS;
+   /* Steady state: change-point detection on the per-instance medians */
+   const unsigned warmup = stats_steady_state_start (series, repm);
+   const double steady_ns = timer_ns (timer, stats_median (series + warmup, repm - warmup));
+   double meta_ns = MIN_META_SECONDS * 1e9;
+   if (meta_ns < 2000 * timer->resolution_ns) meta_ns = 2000 * timer->resolution_ns;
+   const unsigned measure = steady_ns > 0 ? (unsigned) ceil (meta_ns / steady_ns) : 1;
+
+   printf ("STEADY STATE from instance %u/%u (%.6f seconds per instance)\n", warmup+1, repm,
+           steady_ns * 1e-9);
+   if (repm - warmup < repm / 4)
+      printf ("Warning: steady state found late in the series, rerun with more instances\n");
+   printf ("RECOMMENDED: %u warmup repetitions, %u measure repetitions\n", warmup, measure);
+
+   /* steady-state calls, only recorded in the histogram */
+   if (nb_latency > 0) {
+      printf ("Latency run: %u warmup and %u timed instances\n", warmup, nb_latency);
+      float *a = malloc (size * sizeof a[0]);
+      float *b = malloc (size * sizeof b[0]);
+      float (*c)[size] = malloc (size * size * sizeof c[0][0]);
+      init_arrays (size, a, b, c, parallel);
+
+      for (i=0; i<warmup; i++)
+         kernel (size, a, b, c);
+      for (i=0; i<nb_latency; i++) {
+         const uint64_t t1 = timer->start();
+         kernel (size, a, b, c);
+         const uint64_t t2 = timer->stop();
+         hist_record (&latency, timer_elapsed (timer, t1, t2));
+      }
+
+      free (a);
+      free (b);
+      free (c);
+   }
+
+   /* tail latency: what a median hides */
+   static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+   printf ("LATENCY over %lu calls:", latency.total);
+   for (i=0; i<(int) (sizeof quantiles / sizeof quantiles[0]); i++)
+      printf (" p%g %.9f", quantiles[i] * 100, timer_seconds (timer, hist_quantile (&latency, quantiles[i])));
+   printf (" max %.9f mean %.9f seconds\n", timer_seconds (timer, latency.max),
+           latency.total > 0 ? timer_seconds (timer, 1) * latency.sum / latency.total : 0.0);
+
+   int status = EXIT_SUCCESS;
+   if (hist_path != NULL) {
+      if (hist_export (&latency, timer_ns (timer, 1), hist_path) == 0)
+         printf ("Histogram written to %s\n", hist_path);
+      else
+         status = EXIT_FAILURE;
+   }
+
+   if (calib_cfg_write (cfg_path, kv->name, size, warmup, measure) == 0)
+      printf ("Saved to %s, used by ./measure -k %s %u\n", cfg_path, kv->name, size);
+   else
+      status = EXIT_FAILURE;
+
+   free (series);
+   free (x);
+   free (tdiff);
+
+   return status;
 }
@@ -1,71 +1,176 @@
 #include <stdio.h>
-#include <stdlib.h> // atoi
+#include <stdlib.h> // atoi, atof, strtoull
 #include <stdint.h>
+#include <string.h> // strcmp
+#include <math.h>   // fabs
+#include <unistd.h> // getopt
 #include <omp.h>
 
-//extern uint64_t rdtsc ();
+#include "dump.h"
+#include "kernels.h"
+#include "rng.h"
 
-// TODO: adjust for each kernel
-extern void kernel (unsigned n, float a[n], float b[n][n], float c[n][n]);
+#define DEFAULT_MAX_ULP 4
+#define DEFAULT_MAX_REL 1e-5
+#define DEFAULT_NB_WORST 10
+#define NB_TIMED_CALLS 5 /* accuracy table: best of, one call each */
 
 // TODO: adjust for each kernel
-static void init_array_2 (int n, float x[n][n]) {
-   int i, j;
-
-   for (i=0; i<n; i++)
-      for (j=0; j<n; j++)
-         x[i][j] = (float) rand() / RAND_MAX;
+static void init_arrays (int n, float a[n], float b[n], float c[n][n], int parallel) {
+   rng_fill (n, a, RNG_SEED, 0, parallel);
+   rng_fill (n, b, RNG_SEED, 1, parallel);
+   rng_fill ((size_t) n * n, &c[0][0], RNG_SEED, 2, parallel);
 }
 
-static void init_array_1 (int n, float a[n]) {
-   int i;
+/* Output of the kernel computed in double precision from the same inputs,
+   rounded to float. TODO: adjust for each kernel */
+static void reference_output (unsigned n, const float a[n], const float b[n], float c[n][n],
+                              float out[n], double out_d[n]) {
+   unsigned i, j;
 
-   for (i=0; i<n; i++)
-         a[i] = (float) rand() / RAND_MAX;
+   #pragma omp parallel for private(j)
+   for (i=0; i<n; i++) {
+      double sum = 0.0;
+      for (j=0; j<n; j++)
+         sum += c[i][j];
+      out_d[i] = a[i] + sum / b[i];
+      out[i] = (float) out_d[i];
+   }
 }
 
-// TODO: adjust for each kernel
-static void print_array_2 (int n, float a[n][n], const char *output_file_name) {
-   int i, j;
+/* Error of every supported variant against the double-precision reference,
+   with the best time of NB_TIMED_CALLS calls */
+static void accuracy_table (unsigned size) {
+   static struct dump_cmp cmp;
+   unsigned v, i;
 
-   FILE *fp = fopen (output_file_name, "w+");
-   if (fp == NULL) {
-      fprintf (stderr, "Cannot write to %s\n", output_file_name);
-      return;
+   float *a = malloc (size * sizeof a[0]);
+   float *b = malloc (size * sizeof b[0]);
+   float (*c)[size] = malloc (size * size * sizeof c[0][0]);
+   float *ref = malloc (size * sizeof ref[0]);
+   double *ref_d = malloc (size * sizeof ref_d[0]);
+
+   init_arrays (size, a, b, c, 1);
+   reference_output (size, a, b, c, ref, ref_d);
+
+   printf ("Error against a double-precision reference, size %u\n", size);
+   printf ("%-16s %10s %12s %12s %14s\n", "VARIANT", "MAX ULP", "MAX REL", "MEAN REL", "BEST TIME (s)");
+   for (v=0; v<kernels_count(); v++) {
+      const struct kernel_variant *kv = kernels_get (v);
+      if (!kernels_supported (kv)) continue;
+
+      rng_fill (size, a, RNG_SEED, 0, 1); /* a of init_arrays */
+      kv->fn (size, a, b, c);
+      dump_compare (a, ref, size, 0, 0.0, 0, &cmp);
+
+      double sum_rel = 0.0, max_rel = 0.0;
+      for (i=0; i<size; i++) {
+         const double rel = ref_d[i] != 0.0 ? fabs (a[i] - ref_d[i]) / fabs (ref_d[i]) : fabs (a[i]);
+         sum_rel += rel;
+         if (rel > max_rel) max_rel = rel;
+      }
+
+      /* output values are no longer checked, a keeps accumulating */
+      double best = 0.0;
+      for (i=0; i<NB_TIMED_CALLS; i++) {
+         const double t1 = omp_get_wtime ();
+         kv->fn (size, a, b, c);
+         const double t = omp_get_wtime () - t1;
+         if (i == 0 || t < best) best = t;
+      }
+
+      char name [DUMP_NAME_LEN];
+      if (strcmp (kv->name, "SIMD") == 0)
+         snprintf (name, sizeof name, "%s(%s)", kv->name, kernels_selected_isa());
+      else
+         snprintf (name, sizeof name, "%s", kv->name);
+      printf ("%-16s %10lu %12.3e %12.3e %14.6f\n", name, (unsigned long) cmp.max_ulp, max_rel,
+              sum_rel / size, best);
    }
 
-   for (i=0; i<n; i++)
-      for (j=0; j<n; j++)
-         fprintf (fp, "%f\n", a[i][j]);
-
-   fclose (fp);
+   free (a);
+   free (b);
+   free (c);
+   free (ref);
+   free (ref_d);
 }
 
-static void print_array_1 (int n, float a[n], const char *output_file_name) {
-   int i;
+static void usage (const char *prog) {
+   fprintf (stderr, "Usage: %s [-p <plugin.so>]... [-k <variant>] [-i <isa>] [-r <reference dump>] [-u <max ULP>]"
+            " [-e <max relative error>] [-w <nb worst>] <size> [<output dump>]\n"
+            "       %s [-p <plugin.so>]... [-i <isa>] -A <size>\n", prog, prog);
+   fprintf (stderr, "  -p  load a kernel variant from a shared object exporting \"kernel\" (repeatable)\n"
+            "  -k  variant to check (default: %s)\n"
+            "  -i  bind the SIMD variant to avx512, avx2 or sse2 (default: widest supported)\n"
+            "  -r  compare the output against a dump written by a previous run\n"
+            "  -u  per-element tolerance in units in the last place (default: %d)\n"
+            "  -e  per-element relative tolerance (default: %g); an element passes within\n"
+            "      either tolerance\n"
+            "  -w  number of worst elements reported (default: %d, max %d)\n"
+            "  -A  error of every variant against a double-precision reference, with its\n"
+            "      best time over %d calls\n"
+            "The output dump is binary: a header (size, shape, variant) and the raw floats\n",
+            kernels_default()->name, DEFAULT_MAX_ULP, DEFAULT_MAX_REL, DEFAULT_NB_WORST, DUMP_WORST_MAX,
+            NB_TIMED_CALLS);
+}
 
-   FILE *fp = fopen (output_file_name, "w+");
-   if (fp == NULL) {
-      fprintf (stderr, "Cannot write to %s\n", output_file_name);
-      return;
+int main (int argc, char *argv[]) {
+   const struct kernel_variant *kv = kernels_default();
+   const char *isa = NULL;
+   const char *ref_path = NULL;
+   uint64_t max_ulp = DEFAULT_MAX_ULP;
+   double max_rel = DEFAULT_MAX_REL;
+   unsigned nb_worst = DEFAULT_NB_WORST;
+   int accuracy = 0;
+
+   /* check command line options */
+   int opt;
+   while ((opt = getopt (argc, argv, "p:k:i:r:u:e:w:A")) != -1) {
+      switch (opt) {
+      case 'p':
+         if (kernels_load_plugin (optarg) == NULL) return EXIT_FAILURE;
+         break;
+      case 'k':
+         kv = kernels_find (optarg);
+         if (kv == NULL) {
+            fprintf (stderr, "Unknown variant %s (see ./measure -l)\n", optarg);
+            return EXIT_FAILURE;
+         }
+         break;
+      case 'i': isa = optarg; break;
+      case 'r': ref_path = optarg; break;
+      case 'u': max_ulp = strtoull (optarg, NULL, 10); break;
+      case 'e': max_rel = atof (optarg); break;
+      case 'w': nb_worst = atoi (optarg); break;
+      case 'A': accuracy = 1; break;
+      default:
+         usage (argv[0]);
+         return EXIT_FAILURE;
+      }
    }
 
-   for (i=0; i<n; i++)
-         fprintf (fp, "%f\n", a[i]);
+   if (kernels_select_isa (isa) != 0) return EXIT_FAILURE;
 
-   fclose (fp);
-}
+   if (accuracy) {
+      if (argc - optind != 1) {
+         usage (argv[0]);
+         return EXIT_FAILURE;
+      }
+      accuracy_table (atoi (argv[optind]));
+      kernels_unload_plugins ();
+      return EXIT_SUCCESS;
+   }
 
-int main (int argc, char *argv[]) {
    /* check command line arguments */
-   if (argc != 3) {
-      fprintf (stderr, "Usage: %s <size> <output file name>\n", argv[0]);
+   const int nb_args = argc - optind;
+   if (nb_args < 1 || nb_args > 2 || (nb_args == 1 && ref_path == NULL)) {
+      usage (argv[0]);
       return EXIT_FAILURE;
    }
 
    /* get command line arguments */
-   const unsigned size = atoi (argv[1]); /* problem size */
-   const char *output_file_name = argv[2];
+   const unsigned size = atoi (argv[optind]); /* problem size */
+   const char *output_file_name = nb_args == 2 ? argv[optind+1] : NULL;
 
    /* allocate arrays. TODO: adjust for each kernel */
    float *a = malloc (size * sizeof a[0]);
@@ -73,19 +178,47 @@ int main (int argc, char *argv[]) {
    float (*c)[size] = malloc (size * size * sizeof c[0][0]);
 
    /* init arrays */
-   srand(0);
-   init_array_1 (size, a);
-   init_array_1 (size, b);
-   init_array_2 (size, c);
-
-   /* print output */
-   kernel (size, a, b, c);
-   print_array_2 (size, c, output_file_name);
+   init_arrays (size, a, b, c, 1);
+
+   /* SIMD recorded with the ISA it is bound to */
+   char name [DUMP_NAME_LEN];
+   if (strcmp (kv->name, "SIMD") == 0)
+      snprintf (name, sizeof name, "%s(%s)", kv->name, kernels_selected_isa());
+   else
+      snprintf (name, sizeof name, "%s", kv->name);
+
+   /* output: a, the only array written by the kernel. TODO: adjust for each kernel */
+   kv->fn (size, a, b, c);
+   int status = EXIT_SUCCESS;
+   if (output_file_name != NULL && dump_write (output_file_name, name, size, size, 1, a) != 0)
+      status = EXIT_FAILURE;
+
+   if (ref_path != NULL) {
+      struct dump_header hdr;
+      float *ref;
+      if (dump_read (ref_path, &hdr, &ref) != 0) {
+         status = EXIT_FAILURE;
+      } else if (hdr.nb_rows != size || hdr.nb_cols != 1) {
+         fprintf (stderr, "%s holds a %lux%lu output (size %u), expected %ux1\n", ref_path,
+                  (unsigned long) hdr.nb_rows, (unsigned long) hdr.nb_cols, hdr.size, size);
+         status = EXIT_FAILURE;
+         free (ref);
+      } else {
+         static struct dump_cmp cmp;
+         printf ("Comparing %s against %s (%s), tolerances %lu ULP or %g relative\n", name,
+                 ref_path, hdr.variant, (unsigned long) max_ulp, max_rel);
+         dump_compare (a, ref, size, max_ulp, max_rel, nb_worst, &cmp);
+         dump_report (&cmp, hdr.nb_cols, stdout);
+         if (cmp.nb_failed > 0) status = EXIT_FAILURE;
+         free (ref);
+      }
+   }
 
    /* free arrays. TODO: adjust for each kernel */
    free (a);
    free (b);
    free (c);
+   kernels_unload_plugins ();
 
-   return EXIT_SUCCESS;
+   return status;
 }
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h> // atof, exit status
+#include <string.h> // strcmp
+#include <unistd.h> // getopt
+
+#include "env.h"
+#include "record.h"
+#include "stats.h"
+
+#define DEFAULT_ALPHA 0.01
+#define DEFAULT_MIN_CHANGE 1.0 /* percent */
+
+/* Exit status: no significant slowdown, slowdown, error */
+#define EXIT_SLOWER 1
+#define EXIT_ERROR 2
+
+static void usage (const char *prog) {
+   fprintf (stderr, "Usage: %s [-a <alpha>] [-m <min change %%>] <baseline record> <candidate record>\n", prog);
+   fprintf (stderr, "  Compares the samples of each (variant, size) of two ./measure -o records (JSON or CSV)\n"
+            "  with a one-sided Mann-Whitney U test in each direction\n"
+            "  -a  significance level (default: %.2f)\n"
+            "  -m  smallest change of the median reported as slower or faster (default: %.1f %%)\n"
+            "  Exit status: 0 without significant slowdown, %d with one, %d on error\n",
+            DEFAULT_ALPHA, DEFAULT_MIN_CHANGE, EXIT_SLOWER, EXIT_ERROR);
+}
+
+/* Fingerprint fields that differ between the records */
+static void compare_env (const struct env_info *base, const struct env_info *cand) {
+   static const char *keys[] = { "cpu", "governor", "compiler", "cflags", "optflags", "kernel",
+                                 "alloc", "placement", "isa" };
+   const char *b[] = { base->cpu, base->governor, base->compiler, base->cflags, base->optflags, base->kernel,
+                       base->alloc, base->placement, base->isa };
+   const char *c[] = { cand->cpu, cand->governor, cand->compiler, cand->cflags, cand->optflags, cand->kernel,
+                       cand->alloc, cand->placement, cand->isa };
+   unsigned i;
+
+   for (i=0; i<sizeof keys / sizeof keys[0]; i++)
+      if (strcmp (b[i], c[i]) != 0)
+         printf ("WARNING: %s differs: %s -> %s\n", keys[i], b[i], c[i]);
+   if (base->threads != cand->threads)
+      printf ("WARNING: threads differs: %u -> %u\n", base->threads, cand->threads);
+}
+
+int main (int argc, char *argv[]) {
+   double alpha = DEFAULT_ALPHA;
+   double min_change = DEFAULT_MIN_CHANGE / 100;
+   static struct record base, cand;
+   unsigned i, nb_slower = 0;
+
+   int opt;
+   while ((opt = getopt (argc, argv, "a:m:")) != -1) {
+      switch (opt) {
+      case 'a': alpha = atof (optarg); break;
+      case 'm': min_change = atof (optarg) / 100; break;
+      default:
+         usage (argv[0]);
+         return EXIT_ERROR;
+      }
+   }
+   if (argc - optind != 2 || alpha <= 0 || alpha >= 1) {
+      usage (argv[0]);
+      return EXIT_ERROR;
+   }
+
+   if (record_read (argv[optind], &base) != 0) return EXIT_ERROR;
+   if (record_read (argv[optind+1], &cand) != 0) {
+      record_free (&base);
+      return EXIT_ERROR;
+   }
+
+   compare_env (&base.env, &cand.env);
+
+   printf ("%-16s %8s %6s %6s %6s %14s %14s %9s %10s %10s  %s\n", "VARIANT", "SIZE", "CACHES", "N B", "N C",
+           "BASE MED (s)", "CAND MED (s)", "CHANGE", "P SLOWER", "P FASTER", "VERDICT");
+   for (i=0; i<base.nb_sets; i++) {
+      const struct record_set *b = &base.sets[i];
+      const struct record_set *c = record_find (&cand, b->variant, b->size, b->evicted);
+      if (c == NULL) {
+         printf ("%-16s %8u %6s (only in baseline)\n", b->variant, b->size, b->evicted ? "cold" : "warm");
+         continue;
+      }
+
+      const double mb = stats_median (b->samples, b->nb_samples);
+      const double mc = stats_median (c->samples, c->nb_samples);
+      const double change = mb > 0 ? mc / mb - 1 : 0.0;
+      const double p_slower = stats_mann_whitney (b->samples, b->nb_samples, c->samples, c->nb_samples);
+      const double p_faster = stats_mann_whitney (c->samples, c->nb_samples, b->samples, b->nb_samples);
+
+      const char *verdict = "same";
+      if (p_slower < alpha && change > min_change) {
+         verdict = "SLOWER";
+         nb_slower++;
+      } else if (p_faster < alpha && change < -min_change) {
+         verdict = "faster";
+      }
+      printf ("%-16s %8u %6s %6u %6u %14.9f %14.9f %+8.2f%% %10.2e %10.2e  %s\n", b->variant, b->size,
+              b->evicted ? "cold" : "warm", b->nb_samples, c->nb_samples, mb, mc, change * 100, p_slower, p_faster, verdict);
+   }
+   for (i=0; i<cand.nb_sets; i++)
+      if (record_find (&base, cand.sets[i].variant, cand.sets[i].size, cand.sets[i].evicted) == NULL)
+         printf ("%-16s %8u %6s (only in candidate)\n", cand.sets[i].variant, cand.sets[i].size,
+                 cand.sets[i].evicted ? "cold" : "warm");
+
+   if (nb_slower > 0)
+      printf ("%u significant slowdown%s (alpha %.3f, median change above %.1f %%)\n", nb_slower,
+              nb_slower > 1 ? "s" : "", alpha, min_change * 100);
+
+   record_free (&base);
+   record_free (&cand);
+
+   return nb_slower > 0 ? EXIT_SLOWER : EXIT_SUCCESS;
+}
@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h> // atoi, atof, getenv, system, realpath
+#include <limits.h> // PATH_MAX
+#include <stdint.h>
+#include <string.h> // strcmp, memcpy
+#include <math.h>   // INFINITY
+#include <unistd.h> // getopt, access
+#include <sys/stat.h> // mkdir
+#include <omp.h>
+
+#include "bench.h"
+#include "dump.h"
+#include "kernels.h"
+#include "rng.h"
+#include "timer.h"
+#include "topo.h"
+#include "tune_cfg.h"
+
+#define TUNE_WARMUP 10
+#define TUNE_META_SECONDS 0.01
+#define NB_METAS 31
+#define MIN_METAS 5
+#define DEFAULT_TARGET_CI 2.0   /* % of the median */
+#define DEFAULT_BUDGET 5.0      /* seconds per candidate */
+#define MAX_PASSES 3
+#define MAX_CANDIDATES 512
+#define MIN_GAIN 0.01           /* smallest relative gain that moves the descent */
+#define MAX_REL_ERROR 1e-4      /* against NOOPT, candidates beyond are rejected */
+#define CMD_LEN 2048
+
+// TODO: adjust for each kernel
+static void init_arrays (int n, float a[n], float b[n], float c[n][n], int parallel) {
+   rng_fill (n, a, RNG_SEED, 0, parallel);
+   rng_fill (n, b, RNG_SEED, 1, parallel);
+   rng_fill ((size_t) n * n, &c[0][0], RNG_SEED, 2, parallel);
+}
+
+/* Search space, one dimension per parameter */
+enum { P_UNROLL, P_NB_ACC, P_ROW_BLOCK, P_SCHEDULE, P_CHUNK, P_THREADS, NB_PARAMS };
+
+static const char *param_names [NB_PARAMS] = { "unroll", "nb_acc", "row_block", "schedule", "chunk", "threads" };
+static const char *schedules[] = { "static", "dynamic", "guided" };
+
+#define MAX_VALUES 16
+
+struct space {
+   unsigned nb [NB_PARAMS];
+   unsigned values [NB_PARAMS][MAX_VALUES]; /* P_SCHEDULE: index in schedules */
+};
+
+static void init_space (struct space *sp) {
+   static const unsigned unrolls[] = { 1, 2, 4, 8, 16, 32 };
+   static const unsigned accs[] = { 1, 2, 4, 8 };
+   static const unsigned blocks[] = { 1, 2, 4, 8 };
+   static const unsigned chunks[] = { 0, 1, 4, 16, 64 };
+   const unsigned max_threads = omp_get_max_threads ();
+   unsigned i, t;
+
+#define SET(p, tab) do { sp->nb[p] = sizeof tab / sizeof tab[0]; \
+                         for (i=0; i<sp->nb[p]; i++) sp->values[p][i] = tab[i]; } while (0)
+   SET (P_UNROLL, unrolls);
+   SET (P_NB_ACC, accs);
+   SET (P_ROW_BLOCK, blocks);
+   SET (P_CHUNK, chunks);
+#undef SET
+   sp->nb [P_SCHEDULE] = 3;
+   for (i=0; i<3; i++) sp->values [P_SCHEDULE][i] = i;
+
+   /* powers of two up to the default team size, which is included */
+   sp->nb [P_THREADS] = 0;
+   for (t = 1; t < max_threads && sp->nb [P_THREADS] < MAX_VALUES - 1; t *= 2)
+      sp->values [P_THREADS][sp->nb [P_THREADS]++] = t;
+   sp->values [P_THREADS][sp->nb [P_THREADS]++] = max_threads;
+}
+
+static void to_params (const struct space *sp, const unsigned idx [NB_PARAMS], struct tune_params *p) {
+   p->unroll = sp->values [P_UNROLL][idx [P_UNROLL]];
+   p->nb_acc = sp->values [P_NB_ACC][idx [P_NB_ACC]];
+   p->row_block = sp->values [P_ROW_BLOCK][idx [P_ROW_BLOCK]];
+   p->schedule = schedules [sp->values [P_SCHEDULE][idx [P_SCHEDULE]]];
+   p->chunk = sp->values [P_CHUNK][idx [P_CHUNK]];
+   p->threads = sp->values [P_THREADS][idx [P_THREADS]];
+}
+
+static int valid (const struct tune_params *p) {
+   return p->nb_acc <= p->unroll && p->unroll % p->nb_acc == 0;
+}
+
+struct candidate {
+   unsigned idx [NB_PARAMS];
+   double seconds; /* median per call, INFINITY if rejected */
+   double lo, hi;  /* CI of the median per call */
+};
+
+struct tuner {
+   const struct space *sp;
+   struct protocol proto;
+   const char *dir, *template;
+   const float *ref;       /* NOOPT output */
+   unsigned nb_cands;
+   struct candidate cands [MAX_CANDIDATES];
+};
+
+static void object_path (const char *dir, const struct tune_params *p, char path [TUNE_PATH_LEN]) {
+   snprintf (path, TUNE_PATH_LEN, "%s/kernel_u%u_a%u_r%u_%s_c%u_t%u.so", dir, p->unroll, p->nb_acc,
+             p->row_block, p->schedule, p->chunk, p->threads);
+}
+
+/* Compiles the template for p. Returns -1 on failure (compiler output on stderr) */
+static int compile (const struct tuner *tu, const struct tune_params *p, const char *path) {
+   char cmd [CMD_LEN];
+   const char *cc = getenv ("CC") != NULL ? getenv ("CC") : "gcc";
+
+   /* the cache is per CPU model, so the object can target the host */
+   snprintf (cmd, sizeof cmd, "%s -O3 -march=native -fopenmp -fPIC -shared"
+             " -D TUNE_UNROLL=%u -D TUNE_NB_ACC=%u -D TUNE_ROW_BLOCK=%u -D TUNE_SCHEDULE=%s"
+             " -D TUNE_CHUNK=%u -D TUNE_THREADS=%u '%s' -o '%s'", cc, p->unroll, p->nb_acc,
+             p->row_block, p->schedule, p->chunk, p->threads, tu->template, path);
+
+   if (system (cmd) != 0) {
+      fprintf (stderr, "Compilation failed: %s\n", cmd);
+      return -1;
+   }
+
+   return 0;
+}
+
+/* Output of kv within MAX_REL_ERROR of the NOOPT output */
+static int correct (const struct tuner *tu, const struct kernel_variant *kv) {
+   const unsigned size = tu->proto.size;
+   static struct dump_cmp cmp;
+
+   float *a = malloc (size * sizeof a[0]);
+   float *b = malloc (size * sizeof b[0]);
+   float (*c)[size] = malloc (size * size * sizeof c[0][0]);
+   init_arrays (size, a, b, c, 1);
+
+   kv->fn (size, a, b, c);
+   dump_compare (a, tu->ref, size, 0, MAX_REL_ERROR, 0, &cmp);
+
+   free (a);
+   free (b);
+   free (c);
+
+   return cmp.nb_failed == 0;
+}
+
+/* Median seconds per call of kv and its CI with the meta-repetition protocol */
+static void time_variant (struct tuner *tu, const struct kernel_variant *kv, struct candidate *cand) {
+   struct variant_result res = { .kv = kv };
+
+   tu->proto.repm = bench_auto_repm (kv, &tu->proto, TUNE_META_SECONDS);
+   bench_run_metas (&res, &tu->proto);
+   const double s_per_tick = tu->proto.timer->ns_per_tick * 1e-9 / tu->proto.repm;
+   cand->seconds = timer_seconds (tu->proto.timer, res.med) / tu->proto.repm;
+   cand->lo = res.ci_lo * s_per_tick;
+   cand->hi = res.ci_hi * s_per_tick;
+   printf (" %12.9f %8.2f %6u\n", cand->seconds, bench_ci_width (&res) * 100, res.nb_metas);
+   bench_free (&res);
+}
+
+/* Compiles, checks and times a candidate, once per configuration */
+static const struct candidate *evaluate (struct tuner *tu, const unsigned idx [NB_PARAMS]) {
+   static const struct candidate rejected = { .seconds = INFINITY, .lo = INFINITY, .hi = INFINITY };
+   struct tune_params p;
+   char path [TUNE_PATH_LEN];
+   unsigned i;
+
+   for (i=0; i<tu->nb_cands; i++)
+      if (memcmp (tu->cands[i].idx, idx, sizeof tu->cands[i].idx) == 0)
+         return &tu->cands[i];
+   if (tu->nb_cands == MAX_CANDIDATES) return &rejected;
+
+   struct candidate *cand = &tu->cands [tu->nb_cands++];
+   memcpy (cand->idx, idx, sizeof cand->idx);
+   cand->seconds = cand->lo = cand->hi = INFINITY;
+
+   to_params (tu->sp, idx, &p);
+   object_path (tu->dir, &p, path);
+   printf ("%6u %6u %9u %8s %5u %7u", p.unroll, p.nb_acc, p.row_block, p.schedule, p.chunk, p.threads);
+   fflush (stdout);
+
+   if (compile (tu, &p, path) != 0) {
+      printf (" %12s\n", "build failed");
+      return cand;
+   }
+   const struct kernel_variant *kv = kernels_load_plugin (path);
+   if (kv == NULL) {
+      printf (" %12s\n", "load failed");
+      return cand;
+   }
+
+   if (!correct (tu, kv))
+      printf (" %12s\n", "wrong output");
+   else
+      time_variant (tu, kv, cand);
+
+   kernels_unload_plugins ();
+
+   return cand;
+}
+
+/* Whether c beats best beyond the noise: CIs of the medians apart and at
+   least MIN_GAIN faster, any valid candidate beating a rejected one */
+static int faster (const struct candidate *c, const struct candidate *best) {
+   if (c->seconds == INFINITY) return 0;
+   if (best->seconds == INFINITY) return 1;
+
+   return c->hi < best->lo && c->seconds <= best->seconds * (1 - MIN_GAIN);
+}
+
+static void usage (const char *prog) {
+   fprintf (stderr, "Usage: %s [-c <tune file>] [-d <object dir>] [-s <template>] [-t <timer>]"
+            " [-a <target CI %%>] [-T <budget s>] [-n <nb metas>] <size>\n", prog);
+   fprintf (stderr, "  -c  file receiving the best configuration per CPU model and size bucket (default: %s)\n"
+            "  -d  directory of the compiled candidates (default: %s)\n"
+            "  -s  kernel template (default: %s)\n"
+            "  -a  stop timing a candidate once the %.0f%% CI of its median is narrower than this\n"
+            "      percentage of the median (default: %.0f)\n"
+            "  -T  time budget per candidate in seconds (default: %.0f)\n"
+            "  -n  max number of metarepetitions per candidate (default: %d)\n"
+            "Searches unroll, accumulators, row block, OpenMP schedule, chunk and threads one\n"
+            "parameter at a time from the current best, until a pass brings no improvement;\n"
+            "a candidate replaces the best if their %.0f%% CIs are apart and it is at least %.0f%% faster\n"
+            "  -t  timing backend (default: %s), among:\n",
+            TUNE_CFG_DEFAULT, TUNE_DIR_DEFAULT, TUNE_TEMPLATE_DEFAULT, CI_LEVEL * 100,
+            DEFAULT_TARGET_CI, DEFAULT_BUDGET, NB_METAS, CI_LEVEL * 100, MIN_GAIN * 100, TIMER_DEFAULT);
+   timer_list (stderr);
+}
+
+int main (int argc, char *argv[]) {
+   const char *cfg_path = TUNE_CFG_DEFAULT;
+   const char *dir = TUNE_DIR_DEFAULT;
+   const char *template = TUNE_TEMPLATE_DEFAULT;
+   const char *timer_name = TIMER_DEFAULT;
+   double target_ci = DEFAULT_TARGET_CI / 100;
+   double budget = DEFAULT_BUDGET;
+   unsigned nb_metas = NB_METAS;
+
+   /* check command line options */
+   int opt;
+   while ((opt = getopt (argc, argv, "c:d:s:t:a:T:n:")) != -1) {
+      switch (opt) {
+      case 'c': cfg_path = optarg; break;
+      case 'd': dir = optarg; break;
+      case 's': template = optarg; break;
+      case 't': timer_name = optarg; break;
+      case 'a': target_ci = atof (optarg) / 100; break;
+      case 'T': budget = atof (optarg); break;
+      case 'n': nb_metas = atoi (optarg); break;
+      default:
+         usage (argv[0]);
+         return EXIT_FAILURE;
+      }
+   }
+
+   /* check command line arguments */
+   if (argc - optind != 1 || nb_metas < MIN_METAS) {
+      usage (argv[0]);
+      return EXIT_FAILURE;
+   }
+   if (access (template, R_OK) != 0) {
+      fprintf (stderr, "Cannot read the kernel template %s\n", template);
+      return EXIT_FAILURE;
+   }
+   if (mkdir (dir, 0755) != 0 && access (dir, W_OK) != 0) {
+      fprintf (stderr, "Cannot create %s\n", dir);
+      return EXIT_FAILURE;
+   }
+
+   /* get command line arguments */
+   const unsigned size = atoi (argv[optind]); /* problem size */
+
+   struct timer *timer = timer_find (timer_name);
+   if (timer == NULL) {
+      fprintf (stderr, "Unknown timer %s\n", timer_name);
+      usage (argv[0]);
+      return EXIT_FAILURE;
+   }
+   if (timer_init (timer) != 0) return EXIT_FAILURE;
+   printf ("Timer %s: %s\n  resolution %.1f ns, overhead %.1f ns\n", timer->name, timer->desc,
+           timer->resolution_ns, timer_ns (timer, timer->overhead));
+
+   static struct tune_entry best;
+   topo_cpu_model (best.cpu, sizeof best.cpu);
+   best.bucket = tune_size_bucket (size);
+   printf ("Tuning for %s, size %u (bucket %u)\n", best.cpu, size, best.bucket);
+
+   /* reference output for the correctness check of candidates */
+   float *ref = malloc (size * sizeof ref[0]);
+   float *b = malloc (size * sizeof b[0]);
+   float (*c)[size] = malloc (size * size * sizeof c[0][0]);
+   init_arrays (size, ref, b, c, 1);
+   kernels_find ("NOOPT")->fn (size, ref, b, c);
+   free (b);
+   free (c);
+
+   static struct space sp;
+   init_space (&sp);
+
+   static struct tuner tu;
+   tu.sp = &sp;
+   tu.dir = dir;
+   tu.template = template;
+   tu.ref = ref;
+   tu.proto = (struct protocol) {
+      .size = size, .repw = TUNE_WARMUP, .timer = timer, .nb_metas = nb_metas,
+      .min_metas = MIN_METAS, .target_ci = target_ci, .budget = budget, .quiet = 1,
+   };
+
+   /* coordinate descent from unroll 4, 4 accumulators, 1 row, static, default chunk, all threads */
+   unsigned cur [NB_PARAMS] = { 2, 2, 0, 0, 0, sp.nb [P_THREADS] - 1 };
+   printf ("\n%6s %6s %9s %8s %5s %7s %12s %8s %6s\n", "UNROLL", "NB_ACC", "ROW_BLOCK", "SCHEDULE",
+           "CHUNK", "THREADS", "MED (s)", "CI (%)", "METAS");
+   const struct candidate *best_c = evaluate (&tu, cur);
+   const double start_s = best_c->seconds;
+   unsigned pass, p, v;
+
+   for (pass=0; pass<MAX_PASSES; pass++) {
+      int improved = 0;
+      for (p=0; p<NB_PARAMS; p++) {
+         unsigned best_v = cur[p];
+         for (v=0; v<sp.nb[p]; v++) {
+            unsigned idx [NB_PARAMS];
+            struct tune_params params;
+            memcpy (idx, cur, sizeof idx);
+            idx[p] = v;
+            to_params (&sp, idx, &params);
+            if (v == cur[p] || !valid (&params)) continue;
+            const struct candidate *c = evaluate (&tu, idx);
+            if (faster (c, best_c)) {
+               best_c = c;
+               best_v = v;
+            }
+         }
+         if (best_v != cur[p]) {
+            if (p == P_SCHEDULE)
+               printf ("-> %s = %s\n", param_names[p], schedules [best_v]);
+            else
+               printf ("-> %s = %u\n", param_names[p], sp.values[p][best_v]);
+            cur[p] = best_v;
+            improved = 1;
+         }
+      }
+      if (!improved) break;
+   }
+
+   free (ref);
+   const double best_s = best_c->seconds;
+   if (best_s == INFINITY) {
+      fprintf (stderr, "No candidate could be built and validated\n");
+      return EXIT_FAILURE;
+   }
+
+   /* absolute, so that measure -u works from any directory */
+   char rel [TUNE_PATH_LEN], abs [PATH_MAX];
+   to_params (&sp, cur, &best.params);
+   object_path (dir, &best.params, rel);
+   if (realpath (rel, abs) == NULL || strlen (abs) >= TUNE_PATH_LEN) {
+      fprintf (stderr, "Cannot resolve %s into an absolute path of less than %d characters\n", rel, TUNE_PATH_LEN);
+      return EXIT_FAILURE;
+   }
+   snprintf (best.object, sizeof best.object, "%s", abs);
+   best.seconds = best_s;
+   printf ("\nBEST after %u candidates: unroll %u, %u accumulators, row block %u, schedule(%s, %u), %u threads\n",
+           tu.nb_cands, best.params.unroll, best.params.nb_acc, best.params.row_block,
+           best.params.schedule, best.params.chunk, best.params.threads);
+   printf ("MED %.9f seconds per call (%.2fx the starting configuration)\n", best_s, start_s / best_s);
+
+   if (tune_cfg_write (cfg_path, &best) != 0) return EXIT_FAILURE;
+   printf ("Saved to %s, used by ./measure -u %s %u\n", cfg_path, cfg_path, size);
+
+   return EXIT_SUCCESS;
+}
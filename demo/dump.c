@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h> // malloc
+#include <stdint.h>
+#include <string.h> // memcpy, memcmp, strncpy
+#include <math.h>   // fabs, isnan
+
+#include "dump.h"
+
+int dump_write (const char *path, const char *variant, unsigned size,
+                uint64_t nb_rows, uint64_t nb_cols, const float *data) {
+   struct dump_header hdr;
+
+   memset (&hdr, 0, sizeof hdr);
+   memcpy (hdr.magic, DUMP_MAGIC, sizeof hdr.magic);
+   hdr.elem_size = sizeof data[0];
+   hdr.size = size;
+   hdr.nb_rows = nb_rows;
+   hdr.nb_cols = nb_cols;
+   strncpy (hdr.variant, variant, DUMP_NAME_LEN - 1);
+
+   FILE *fp = fopen (path, "wb");
+   if (fp == NULL) {
+      fprintf (stderr, "Cannot write to %s\n", path);
+      return -1;
+   }
+
+   const uint64_t n = nb_rows * nb_cols;
+   int status = 0;
+   if (fwrite (&hdr, sizeof hdr, 1, fp) != 1 || fwrite (data, sizeof data[0], n, fp) != n) {
+      fprintf (stderr, "Cannot write to %s\n", path);
+      status = -1;
+   }
+   if (fclose (fp) != 0) status = -1;
+
+   return status;
+}
+
+int dump_read (const char *path, struct dump_header *hdr, float **data) {
+   FILE *fp = fopen (path, "rb");
+   if (fp == NULL) {
+      fprintf (stderr, "Cannot read %s\n", path);
+      return -1;
+   }
+
+   if (fread (hdr, sizeof *hdr, 1, fp) != 1 || memcmp (hdr->magic, DUMP_MAGIC, sizeof hdr->magic) != 0 ||
+       hdr->elem_size != sizeof (float)) {
+      fprintf (stderr, "%s is not a float dump written by check\n", path);
+      fclose (fp);
+      return -1;
+   }
+   hdr->variant [DUMP_NAME_LEN - 1] = '\0';
+
+   const uint64_t n = hdr->nb_rows * hdr->nb_cols;
+   *data = malloc (n * sizeof (float));
+   if (*data == NULL || fread (*data, sizeof (float), n, fp) != n) {
+      fprintf (stderr, "%s is truncated\n", path);
+      free (*data);
+      *data = NULL;
+      fclose (fp);
+      return -1;
+   }
+
+   fclose (fp);
+
+   return 0;
+}
+
+/* Floats mapped to integers in the same order, so that adjacent floats differ by 1 */
+static int64_t ordered (float x) {
+   int32_t i;
+
+   memcpy (&i, &x, sizeof i);
+   return i < 0 ? (int64_t) INT32_MIN - i : i;
+}
+
+static uint64_t ulp_distance (float x, float y) {
+   if (isnan (x) || isnan (y)) return isnan (x) && isnan (y) ? 0 : UINT64_MAX;
+
+   const int64_t d = ordered (x) - ordered (y);
+   return d < 0 ? -d : d;
+}
+
+static int worse (const struct dump_offender *a, const struct dump_offender *b) {
+   return a->ulp > b->ulp || (a->ulp == b->ulp && a->rel > b->rel);
+}
+
+/* Insertion into worst[0..*nb-1], kept sorted by decreasing badness, at most max */
+static void keep_worst (struct dump_offender worst[], unsigned *nb, unsigned max,
+                        const struct dump_offender *o) {
+   unsigned i;
+
+   if (max == 0 || (*nb == max && !worse (o, &worst [max-1]))) return;
+
+   i = *nb < max ? (*nb)++ : max - 1;
+   for (; i > 0 && worse (o, &worst [i-1]); i--)
+      worst[i] = worst [i-1];
+   worst[i] = *o;
+}
+
+void dump_compare (const float *out, const float *ref, uint64_t n, uint64_t max_ulp,
+                   double max_rel, unsigned nb_worst, struct dump_cmp *cmp) {
+   uint64_t nb_failed = 0, max_u = 0;
+   double max_r = 0.0;
+   uint64_t i;
+
+   if (nb_worst > DUMP_WORST_MAX) nb_worst = DUMP_WORST_MAX;
+   cmp->nb_elems = n;
+   cmp->nb_worst = 0;
+
+   #pragma omp parallel reduction(+:nb_failed) reduction(max:max_u,max_r)
+   {
+      struct dump_offender worst [DUMP_WORST_MAX];
+      unsigned nb = 0, k;
+
+      #pragma omp for schedule(static)
+      for (i=0; i<n; i++) {
+         const uint64_t ulp = ulp_distance (out[i], ref[i]);
+         const double diff = fabs ((double) out[i] - ref[i]);
+         const double rel = ref[i] != 0.0f ? diff / fabs (ref[i]) : (diff != 0.0 ? INFINITY : 0.0);
+
+         if (ulp > max_u) max_u = ulp;
+         if (rel > max_r || isnan (rel)) max_r = isnan (rel) ? INFINITY : rel;
+         if (ulp == 0) continue;
+         if (ulp > max_ulp && !(rel <= max_rel)) nb_failed++;
+
+         const struct dump_offender o = { .index = i, .ulp = ulp, .rel = rel, .out = out[i], .ref = ref[i] };
+         keep_worst (worst, &nb, nb_worst, &o);
+      }
+
+      #pragma omp critical
+      for (k=0; k<nb; k++)
+         keep_worst (cmp->worst, &cmp->nb_worst, nb_worst, &worst[k]);
+   }
+
+   cmp->nb_failed = nb_failed;
+   cmp->max_ulp = max_u;
+   cmp->max_rel = max_r;
+}
+
+void dump_report (const struct dump_cmp *cmp, uint64_t nb_cols, FILE *fp) {
+   unsigned k;
+
+   fprintf (fp, "%lu/%lu elements beyond tolerances, max %lu ULP, max relative error %.3e\n",
+            (unsigned long) cmp->nb_failed, (unsigned long) cmp->nb_elems,
+            (unsigned long) cmp->max_ulp, cmp->max_rel);
+   if (cmp->nb_worst == 0) return;
+
+   fprintf (fp, "%-20s %16s %16s %12s %12s\n", "INDEX", "OUTPUT", "REFERENCE", "ULP", "REL ERROR");
+   for (k=0; k<cmp->nb_worst; k++) {
+      const struct dump_offender *o = &cmp->worst[k];
+      char index [48];
+      if (nb_cols > 1)
+         snprintf (index, sizeof index, "[%lu][%lu]", (unsigned long) (o->index / nb_cols),
+                   (unsigned long) (o->index % nb_cols));
+      else
+         snprintf (index, sizeof index, "[%lu]", (unsigned long) o->index);
+      fprintf (fp, "%-20s %16.9g %16.9g %12lu %12.3e\n", index, o->out, o->ref,
+               (unsigned long) o->ulp, o->rel);
+   }
+}
@@ -0,0 +1,56 @@
+#ifndef DUMP_H
+#define DUMP_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Binary dumps of kernel outputs written by ./check, and their comparison
+   against a reference dump with per-element ULP and relative tolerances */
+
+#define DUMP_MAGIC "KDUMP01"
+#define DUMP_NAME_LEN 64
+
+/* Native byte order, followed by nb_rows x nb_cols row-major floats */
+struct dump_header {
+   char magic [8];
+   uint32_t elem_size;  /* sizeof (float) */
+   uint32_t size;       /* problem size */
+   uint64_t nb_rows, nb_cols;
+   char variant [DUMP_NAME_LEN];
+};
+
+/* Returns -1 on I/O error (reported on stderr) */
+int dump_write (const char *path, const char *variant, unsigned size,
+                uint64_t nb_rows, uint64_t nb_cols, const float *data);
+
+/* Reads header and data (malloc-ed in *data). Returns -1 on I/O error or
+   invalid header (reported on stderr) */
+int dump_read (const char *path, struct dump_header *hdr, float **data);
+
+#define DUMP_WORST_MAX 64
+
+struct dump_offender {
+   uint64_t index;  /* element index, row-major */
+   uint64_t ulp;    /* distance in units in the last place, UINT64_MAX if one side is NaN */
+   double rel;      /* |out - ref| / |ref| */
+   float out, ref;
+};
+
+struct dump_cmp {
+   uint64_t nb_elems;
+   uint64_t nb_failed;  /* beyond both tolerances */
+   uint64_t max_ulp;
+   double max_rel;
+   unsigned nb_worst;   /* worst offenders by ULP, decreasing */
+   struct dump_offender worst [DUMP_WORST_MAX];
+};
+
+/* Compares n elements in parallel. An element passes when within max_ulp or
+   within max_rel of the reference. Keeps the nb_worst worst elements */
+void dump_compare (const float *out, const float *ref, uint64_t n, uint64_t max_ulp,
+                   double max_rel, unsigned nb_worst, struct dump_cmp *cmp);
+
+/* Summary and worst offenders, indices as [row][col] for matrices */
+void dump_report (const struct dump_cmp *cmp, uint64_t nb_cols, FILE *fp);
+
+#endif
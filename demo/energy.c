@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h> // getenv, qsort, strtoull
+#include <string.h> // strncmp, strchr, strcspn, strerror
+#include <errno.h>
+#include <math.h>   // NAN
+#include <dirent.h>
+#include <fcntl.h>  // open
+#include <unistd.h> // pread, close
+
+#include "energy.h"
+
+#define MAX_ZONES 64
+
+/* First line of <root>/<zone>/<file>. Returns -1 if not readable */
+static int read_attr (const char *root, const char *zone, const char *file, char *buf, size_t len) {
+   char path [512];
+
+   snprintf (path, sizeof path, "%s/%s/%s", root, zone, file);
+   FILE *fp = fopen (path, "r");
+   if (fp == NULL) return -1;
+   const int ok = fgets (buf, len, fp) != NULL;
+   fclose (fp);
+   if (!ok) return -1;
+   buf [strcspn (buf, "\n")] = '\0';
+
+   return 0;
+}
+
+static int cmp_str (const void *a, const void *b) {
+   return strcmp ((const char *) a, (const char *) b);
+}
+
+/* Adds zone if it is a package or a DRAM domain. Returns -1 with e->status
+   set if its counter cannot be read */
+static int add_zone (struct energy *e, const char *zone) {
+   char name [32], parent [32], parent_name [32], range [32], path [512];
+
+   if (read_attr (e->root, zone, "name", name, sizeof name) != 0) return 0;
+
+   struct energy_domain *d = &e->domains [e->nb_domains];
+   const char *sub = strchr (zone + strlen ("intel-rapl:"), ':');
+   if (sub == NULL) {
+      if (strncmp (name, "package", 7) != 0) return 0; /* psys */
+      snprintf (d->name, sizeof d->name, "%s", name);
+   } else {
+      if (strcmp (name, "dram") != 0) return 0; /* core, uncore: included in the package */
+      snprintf (parent, sizeof parent, "%.*s", (int) (sub - zone), zone);
+      if (read_attr (e->root, parent, "name", parent_name, sizeof parent_name) != 0)
+         snprintf (parent_name, sizeof parent_name, "%s", parent);
+      snprintf (d->name, sizeof d->name, "%.23s/%.23s", parent_name, name);
+   }
+
+   d->max_range = 0;
+   if (read_attr (e->root, zone, "max_energy_range_uj", range, sizeof range) == 0)
+      d->max_range = strtoull (range, NULL, 10);
+
+   snprintf (path, sizeof path, "%s/%s/energy_uj", e->root, zone);
+   d->fd = open (path, O_RDONLY);
+   char probe [32];
+   if (d->fd < 0 || pread (d->fd, probe, sizeof probe - 1, 0) <= 0) {
+      snprintf (e->status, sizeof e->status, "%.100s not readable (%.40s)%s", path, strerror (errno),
+                errno == EACCES ? ", root only since Linux 5.10" : "");
+      if (d->fd >= 0) close (d->fd);
+      return -1;
+   }
+   e->nb_domains++;
+
+   return 0;
+}
+
+unsigned energy_open (struct energy *e) {
+   static char zones [MAX_ZONES][64];
+   unsigned nb_zones = 0, i;
+   struct dirent *ent;
+
+   const char *root = getenv (ENERGY_ROOT_ENV);
+   snprintf (e->root, sizeof e->root, "%s", root != NULL ? root : ENERGY_ROOT_DEFAULT);
+   e->nb_domains = 0;
+   e->status[0] = '\0';
+
+   DIR *dir = opendir (e->root);
+   if (dir == NULL) {
+      snprintf (e->status, sizeof e->status, "no %.120s (%.60s)", e->root, strerror (errno));
+      return 0;
+   }
+   /* intel-rapl:<package>[:<subzone>], the mmio duplicates left out */
+   while ((ent = readdir (dir)) != NULL && nb_zones < MAX_ZONES)
+      if (strncmp (ent->d_name, "intel-rapl:", 11) == 0)
+         snprintf (zones [nb_zones++], sizeof zones[0], "%.63s", ent->d_name);
+   closedir (dir);
+   qsort (zones, nb_zones, sizeof zones[0], cmp_str);
+
+   for (i=0; i<nb_zones && e->nb_domains < ENERGY_MAX_DOMAINS; i++) {
+      if (add_zone (e, zones[i]) != 0) {
+         energy_close (e);
+         return 0;
+      }
+   }
+
+   if (e->nb_domains == 0 && e->status[0] == '\0')
+      snprintf (e->status, sizeof e->status, "no intel-rapl package domain under %.150s", e->root);
+
+   return e->nb_domains;
+}
+
+int energy_read (const struct energy *e, uint64_t uj [ENERGY_MAX_DOMAINS]) {
+   char buf [32];
+   unsigned d;
+
+   for (d=0; d<e->nb_domains; d++) {
+      const ssize_t len = pread (e->domains[d].fd, buf, sizeof buf - 1, 0);
+      if (len <= 0) return -1;
+      buf[len] = '\0';
+      uj[d] = strtoull (buf, NULL, 10);
+   }
+
+   return 0;
+}
+
+double energy_joules (const struct energy *e, unsigned d, uint64_t before, uint64_t after) {
+   const uint64_t max_range = e->domains[d].max_range;
+
+   if (after >= before) return (after - before) * 1e-6;
+
+   /* wrapped: the counter went through max_range back to 0, unknown without
+      max_energy_range_uj */
+   if (max_range == 0 || before > max_range) return NAN;
+   return (max_range - before + after + 1) * 1e-6;
+}
+
+void energy_close (struct energy *e) {
+   unsigned d;
+
+   for (d=0; d<e->nb_domains; d++)
+      close (e->domains[d].fd);
+   e->nb_domains = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stdint.h>
+
+/* Package and DRAM energy counters of the powercap interface (Intel RAPL,
+   also exposed by recent AMD kernels under the same name), read around each
+   meta-repetition by the measure driver. The sysfs root can be redirected to
+   a fake tree with the ENERGY_ROOT_ENV environment variable:
+     <root>/intel-rapl:0/{name,energy_uj,max_energy_range_uj}     package
+     <root>/intel-rapl:0:0/{name,energy_uj,max_energy_range_uj}   subzone (dram...) */
+
+#define ENERGY_ROOT_DEFAULT "/sys/class/powercap"
+#define ENERGY_ROOT_ENV "MEASURE_POWERCAP_ROOT"
+#define ENERGY_MAX_DOMAINS 8
+
+struct energy_domain {
+   char name [48];     /* "package-0", "package-0/dram" */
+   int fd;             /* energy_uj, kept open */
+   uint64_t max_range; /* counter wraps to 0 after this value, in uJ, 0 if unknown */
+};
+
+struct energy {
+   unsigned nb_domains;
+   struct energy_domain domains [ENERGY_MAX_DOMAINS];
+   char root [256];
+   char status [192]; /* why no domain is available */
+};
+
+/* Opens the package and DRAM domains under the root. Returns their number,
+   0 (with e->status set) if the counters are missing or not readable */
+unsigned energy_open (struct energy *e);
+
+/* Current counter of each domain, in uJ. Returns -1 if a read fails */
+int energy_read (const struct energy *e, uint64_t uj [ENERGY_MAX_DOMAINS]);
+
+/* Joules between two reads of domain d, across one wraparound. NAN if the
+   counter went back while the wrap value is unknown (no max_energy_range_uj) */
+double energy_joules (const struct energy *e, unsigned d, uint64_t before, uint64_t after);
+
+void energy_close (struct energy *e);
+
+#endif
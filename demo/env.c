@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <string.h> // strcspn
+#include <sys/utsname.h>
+#include <omp.h>
+
+#include "env.h"
+#include "topo.h"
+
+#ifndef BUILD_CFLAGS
+#define BUILD_CFLAGS "unknown"
+#endif
+#ifndef BUILD_OPTFLAGS
+#define BUILD_OPTFLAGS "unknown"
+#endif
+
+/* First line of a sysfs file, "unknown" if not readable */
+static void read_line (const char *path, char *buf, size_t len) {
+   FILE *fp = fopen (path, "r");
+
+   snprintf (buf, len, "unknown");
+   if (fp == NULL) return;
+   if (fgets (buf, len, fp) != NULL)
+      buf [strcspn (buf, "\n")] = '\0';
+   else
+      snprintf (buf, len, "unknown");
+   fclose (fp);
+}
+
+void env_collect (struct env_info *env) {
+   struct utsname u;
+
+   topo_cpu_model (env->cpu, sizeof env->cpu);
+   read_line ("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor", env->governor, sizeof env->governor);
+#ifdef __VERSION__
+   snprintf (env->compiler, sizeof env->compiler, "%s", __VERSION__);
+#else
+   snprintf (env->compiler, sizeof env->compiler, "unknown");
+#endif
+   snprintf (env->cflags, sizeof env->cflags, "%s", BUILD_CFLAGS);
+   snprintf (env->optflags, sizeof env->optflags, "%s", BUILD_OPTFLAGS);
+   if (uname (&u) == 0)
+      snprintf (env->kernel, sizeof env->kernel, "%.32s %.90s", u.sysname, u.release);
+   else
+      snprintf (env->kernel, sizeof env->kernel, "unknown");
+   snprintf (env->alloc, sizeof env->alloc, "unknown");
+   snprintf (env->placement, sizeof env->placement, "unknown");
+   snprintf (env->isa, sizeof env->isa, "unknown");
+   env->threads = omp_get_max_threads();
+}
+
+void env_print (const struct env_info *env, const char *prefix, FILE *fp) {
+   fprintf (fp, "%scpu: %s\n", prefix, env->cpu);
+   fprintf (fp, "%sgovernor: %s\n", prefix, env->governor);
+   fprintf (fp, "%scompiler: %s\n", prefix, env->compiler);
+   fprintf (fp, "%scflags: %s\n", prefix, env->cflags);
+   fprintf (fp, "%soptflags: %s\n", prefix, env->optflags);
+   fprintf (fp, "%skernel: %s\n", prefix, env->kernel);
+   fprintf (fp, "%salloc: %s\n", prefix, env->alloc);
+   fprintf (fp, "%splacement: %s\n", prefix, env->placement);
+   fprintf (fp, "%sisa: %s\n", prefix, env->isa);
+   fprintf (fp, "%sthreads: %u\n", prefix, env->threads);
+}
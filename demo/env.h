@@ -0,0 +1,31 @@
+#ifndef ENV_H
+#define ENV_H
+
+#include <stdio.h>
+
+/* Environment fingerprint recorded next to the results, so that result sets
+   from different hosts or builds are not compared blindly */
+
+#define ENV_STR_LEN 128
+
+struct env_info {
+   char cpu [ENV_STR_LEN];      /* model name, blanks replaced by '_' */
+   char governor [ENV_STR_LEN]; /* cpufreq governor of cpu0, "unknown" without cpufreq */
+   char compiler [ENV_STR_LEN]; /* that built the drivers */
+   char cflags [ENV_STR_LEN];   /* drivers */
+   char optflags [ENV_STR_LEN]; /* kernel variants */
+   char kernel [ENV_STR_LEN];   /* OS release (uname -r) */
+   char alloc [ENV_STR_LEN];    /* array allocation mode, after probing */
+   char placement [ENV_STR_LEN]; /* thread pinning and memory policy */
+   char isa [ENV_STR_LEN];      /* SIMD variant binding */
+   unsigned threads;            /* OpenMP threads */
+};
+
+/* Host and build fields; alloc, placement and isa are "unknown", set by the
+   driver from its options */
+void env_collect (struct env_info *env);
+
+/* "key: value" lines, each prefixed by prefix */
+void env_print (const struct env_info *env, const char *prefix, FILE *fp);
+
+#endif
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h> // malloc
+#include <stdint.h>
+#include <string.h> // strcmp, memset
+#if defined __i386 || defined __amd64
+#include <cpuid.h>
+#endif
+
+#include "evict.h"
+#include "topo.h"
+
+#define DEFAULT_SWEEP_BYTES (64UL << 20) /* without cache description in sysfs */
+
+volatile char evict_sink; /* keeps the sweep loads */
+
+int evict_parse (const char *str, enum evict_method *method) {
+   if (strcmp (str, "sweep") == 0) *method = EVICT_SWEEP;
+   else if (strcmp (str, "flush") == 0) *method = EVICT_FLUSH;
+   else return -1;
+
+   return 0;
+}
+
+/* CLFLUSHOPT: CPUID 7.0, EBX bit 23 */
+static int has_clflushopt (void) {
+#if defined __i386 || defined __amd64
+   unsigned eax, ebx, ecx, edx;
+   if (!__get_cpuid_count (7, 0, &eax, &ebx, &ecx, &edx)) return 0;
+   return (ebx >> 23) & 1;
+#else
+   return 0;
+#endif
+}
+
+int evict_init (struct evictor *ev, enum evict_method method) {
+   struct cache_level caches [TOPO_MAX_CACHES];
+   const unsigned nb_caches = topo_caches (caches);
+
+   ev->line_size = nb_caches > 0 ? caches[0].line_size : 64;
+   ev->len = nb_caches > 0 ? 2 * caches [nb_caches-1].size : DEFAULT_SWEEP_BYTES;
+   ev->buf = NULL;
+
+   if (method == EVICT_FLUSH && !has_clflushopt()) {
+      fprintf (stderr, "clflushopt not supported, evicting with a sweep\n");
+      method = EVICT_SWEEP;
+   }
+   ev->method = method;
+   if (method == EVICT_FLUSH) return 0;
+
+   ev->buf = malloc (ev->len);
+   if (ev->buf == NULL) {
+      fprintf (stderr, "Cannot allocate a %lu-byte eviction buffer\n", (unsigned long) ev->len);
+      return -1;
+   }
+   memset (ev->buf, 1, ev->len);
+
+   return 0;
+}
+
+static void sweep (const struct evictor *ev) {
+   const size_t nb_lines = ev->len / ev->line_size;
+   char sum = 0;
+   size_t i;
+
+   /* all threads: each one also flushes its private levels */
+   #pragma omp parallel for schedule(static) reduction(+:sum)
+   for (i=0; i<nb_lines; i++)
+      sum += ev->buf [i * ev->line_size];
+
+   evict_sink = sum;
+}
+
+static void flush (const struct evictor *ev, unsigned nb, void *const arrays[], const size_t lens[]) {
+#if defined __i386 || defined __amd64
+   unsigned k;
+
+   #pragma omp parallel private(k)
+   {
+      for (k=0; k<nb; k++) {
+         char *p = arrays[k];
+         const size_t nb_lines = (lens[k] + ev->line_size - 1) / ev->line_size;
+         size_t i;
+         #pragma omp for schedule(static) nowait
+         for (i=0; i<nb_lines; i++)
+            __asm__ volatile ("clflushopt %0" : "+m" (p [i * ev->line_size]));
+      }
+      /* clflushopt is only ordered by fences */
+      __asm__ volatile ("sfence" ::: "memory");
+   }
+#else
+   (void) ev; (void) nb; (void) arrays; (void) lens;
+#endif
+}
+
+void evict (const struct evictor *ev, unsigned nb, void *const arrays[], const size_t lens[]) {
+   if (ev->method == EVICT_FLUSH)
+      flush (ev, nb, arrays, lens);
+   else
+      sweep (ev);
+}
+
+void evict_describe (const struct evictor *ev, FILE *fp) {
+   if (ev->method == EVICT_FLUSH)
+      fprintf (fp, "Eviction: clflushopt over the kernel arrays before each timed call\n");
+   else
+      fprintf (fp, "Eviction: sweep over a %.1f MB buffer before each timed call\n", ev->len / 1e6);
+}
+
+void evict_free (struct evictor *ev) {
+   free (ev->buf);
+   ev->buf = NULL;
+}
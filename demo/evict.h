@@ -0,0 +1,37 @@
+#ifndef EVICT_H
+#define EVICT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Cache eviction before timed calls (cold-cache measurements) */
+
+enum evict_method {
+   EVICT_SWEEP, /* parallel read sweep over a buffer twice the last-level cache */
+   EVICT_FLUSH, /* clflushopt over the kernel arrays */
+};
+
+struct evictor {
+   enum evict_method method;
+   unsigned line_size; /* bytes */
+   size_t len;         /* sweep buffer, in bytes */
+   char *buf;
+};
+
+/* "sweep" or "flush". Returns -1 if invalid */
+int evict_parse (const char *str, enum evict_method *method);
+
+/* Sizes the sweep buffer from the cache hierarchy. flush falls back to
+   sweep (reported on stderr) without clflushopt. Returns -1 if the buffer
+   cannot be allocated */
+int evict_init (struct evictor *ev, enum evict_method method);
+
+/* Evicts the nb arrays (lens in bytes) from all cache levels */
+void evict (const struct evictor *ev, unsigned nb, void *const arrays[], const size_t lens[]);
+
+/* One line describing the eviction method, recorded next to the results */
+void evict_describe (const struct evictor *ev, FILE *fp);
+
+void evict_free (struct evictor *ev);
+
+#endif
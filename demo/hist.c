@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <string.h> // memset
+#include <math.h>   // ceil
+
+#include "hist.h"
+
+void hist_init (struct hist *h) {
+   memset (h->counts, 0, sizeof h->counts);
+   h->total = 0;
+   h->min = UINT64_MAX;
+   h->max = 0;
+   h->sum = 0.0;
+}
+
+uint64_t hist_lowest (unsigned index) {
+   if (index < 2 * HIST_HALF) return index;
+
+   const unsigned shift = index / HIST_HALF - 1;
+   return (uint64_t) (index % HIST_HALF + HIST_HALF) << shift;
+}
+
+uint64_t hist_highest (unsigned index) {
+   if (index < 2 * HIST_HALF) return index;
+
+   const unsigned shift = index / HIST_HALF - 1;
+   return hist_lowest (index) + ((uint64_t) 1 << shift) - 1;
+}
+
+uint64_t hist_quantile (const struct hist *h, double q) {
+   if (h->total == 0) return 0;
+
+   uint64_t rank = (uint64_t) ceil (q * h->total);
+   if (rank == 0) rank = 1;
+   uint64_t cumul = 0;
+   unsigned i;
+
+   for (i=0; i<HIST_NB_COUNTS; i++) {
+      cumul += h->counts[i];
+      if (cumul >= rank) {
+         const uint64_t v = hist_highest (i);
+         return v < h->max ? v : h->max;
+      }
+   }
+
+   return h->max;
+}
+
+int hist_export (const struct hist *h, double ns_per_value, const char *path) {
+   uint64_t cumul = 0;
+   unsigned i;
+
+   FILE *fp = fopen (path, "w");
+   if (fp == NULL) {
+      fprintf (stderr, "Cannot write to %s\n", path);
+      return -1;
+   }
+
+   fprintf (fp, "# %lu values, min %.1f ns, max %.1f ns, %u sub-buckets per power of two\n", h->total,
+            h->total > 0 ? h->min * ns_per_value : 0.0, h->max * ns_per_value, HIST_HALF);
+   fprintf (fp, "lowest_ns,highest_ns,count,cumulative_fraction\n");
+   for (i=0; i<HIST_NB_COUNTS; i++) {
+      if (h->counts[i] == 0) continue;
+      cumul += h->counts[i];
+      fprintf (fp, "%.1f,%.1f,%lu,%.6f\n", hist_lowest (i) * ns_per_value, hist_highest (i) * ns_per_value,
+               h->counts[i], (double) cumul / h->total);
+   }
+
+   if (fclose (fp) != 0) {
+      fprintf (stderr, "Cannot write to %s\n", path);
+      return -1;
+   }
+
+   return 0;
+}
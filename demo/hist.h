@@ -0,0 +1,52 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Latency histogram in the style of HdrHistogram: log-linear buckets with
+   2^HIST_SUB_BITS sub-buckets per power of two, so every value up to 2^64
+   is recorded with a relative error below 2^-HIST_SUB_BITS in constant
+   memory (HIST_NB_COUNTS counters). Recording is a few integer operations */
+
+#define HIST_SUB_BITS 7 /* 0.8 % precision, about 2 significant digits */
+#define HIST_HALF (1U << HIST_SUB_BITS)
+#define HIST_NB_COUNTS (HIST_HALF * (65 - HIST_SUB_BITS))
+
+struct hist {
+   uint64_t counts [HIST_NB_COUNTS];
+   uint64_t total;
+   uint64_t min, max;
+   double sum; /* for the mean */
+};
+
+void hist_init (struct hist *h);
+
+static inline unsigned hist_index (uint64_t v) {
+   if (v < 2 * HIST_HALF) return (unsigned) v;
+
+   const unsigned shift = 63 - __builtin_clzll (v) - HIST_SUB_BITS;
+   return HIST_HALF * (shift + 1) + (unsigned) (v >> shift) - HIST_HALF;
+}
+
+static inline void hist_record (struct hist *h, uint64_t v) {
+   h->counts [hist_index (v)]++;
+   h->total++;
+   h->sum += v;
+   if (v < h->min) h->min = v;
+   if (v > h->max) h->max = v;
+}
+
+/* Smallest and largest values sharing the bucket of index */
+uint64_t hist_lowest (unsigned index);
+uint64_t hist_highest (unsigned index);
+
+/* Value at quantile q (0.5, 0.99...): highest value of the bucket reaching
+   q * total, capped to max. 0 if empty */
+uint64_t hist_quantile (const struct hist *h, double q);
+
+/* Non-empty buckets as CSV "lowest_ns,highest_ns,count,cumulative_fraction",
+   values converted with ns_per_value. Returns -1 on I/O error */
+int hist_export (const struct hist *h, double ns_per_value, const char *path);
+
+#endif
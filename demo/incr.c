@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h> // memcpy
+#include <math.h>   // fabsf
+
+#include "incr.h"
+#include "kctx.h"
+#include "rng.h"
+#include "stats.h"
+
+int incr_parse (const char *str, double *max_fraction) {
+   char *end;
+
+   *max_fraction = strtod (str, &end);
+   if (*end != '\0' || !(*max_fraction > 0.0) || *max_fraction > 1.0) return -1;
+
+   return 0;
+}
+
+/* xorshift64*: dirty rows drawn from a local stream */
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint64_t rng_next (void) {
+   rng_state ^= rng_state >> 12;
+   rng_state ^= rng_state << 25;
+   rng_state ^= rng_state >> 27;
+   return rng_state * 2685821657736338717ULL;
+}
+
+static float rng_float (void) {
+   return (rng_next() >> 40) * (1.0f / (1 << 24));
+}
+
+/* Modifies nb random distinct rows of c and nb random entries of b, declared
+   to ctx. perm is a permutation of the row indices, shuffled in place */
+static void modify (struct kernel_ctx *ctx, unsigned n, float b[n], float c[n][n],
+                    unsigned perm[n], unsigned nb) {
+   unsigned t, j;
+
+   for (t=0; t<nb; t++) {
+      const unsigned k = t + rng_next() % (n - t);
+      const unsigned r = perm[k];
+      perm[k] = perm[t];
+      perm[t] = r;
+
+      for (j=0; j<n; j++)
+         c[r][j] = rng_float();
+      kctx_update_row (ctx, r);
+   }
+
+   for (t=0; t<nb; t++) {
+      const unsigned r = rng_next() % n;
+      b[r] = rng_float();
+      kctx_update_b (ctx, r);
+   }
+}
+
+// TODO: adjust for each kernel
+static void init_arrays (unsigned n, float a[n], float b[n], float c[n][n], int parallel) {
+   rng_fill (n, a, RNG_SEED, 0, parallel);
+   rng_fill (n, b, RNG_SEED, 1, parallel);
+   rng_fill ((size_t) n * n, &c[0][0], RNG_SEED, 2, parallel);
+}
+
+/* Largest relative difference between one incremental call and one full call
+   of kv on the same modified inputs */
+static float check (struct kernel_ctx *ctx, const struct kernel_variant *kv, unsigned n,
+                    float a[n], float b[n], float c[n][n], unsigned perm[n], unsigned nb) {
+   float *ref = malloc (n * sizeof ref[0]);
+   float max_rel = 0.0f;
+   unsigned i;
+
+   modify (ctx, n, b, c, perm, nb);
+   memcpy (ref, a, n * sizeof ref[0]);
+   kv->fn (n, ref, b, c);
+   kctx_kernel (ctx, n, a, b, c);
+
+   for (i=0; i<n; i++) {
+      const float rel = fabsf (a[i] - ref[i]) / (fabsf (ref[i]) > 0.0f ? fabsf (ref[i]) : 1.0f);
+      if (rel > max_rel) max_rel = rel;
+   }
+
+   free (ref);
+   return max_rel;
+}
+
+void incr_run (struct variant_result res[], unsigned nb, const struct protocol *proto,
+               double max_fraction, FILE *out) {
+   const unsigned size = proto->size;
+   const struct timer *timer = proto->timer;
+   const unsigned nb_calls = proto->nb_metas * proto->repm;
+   unsigned i, v;
+
+   /* full calls first, as in the default mode */
+   for (v=0; v<nb; v++)
+      bench_run_metas (&res[v], proto);
+
+   if (proto->placement != NULL) placement_pin_threads (proto->placement);
+   float *a = placement_alloc_or_exit (proto->placement, size, sizeof a[0]);
+   float *b = placement_alloc_or_exit (proto->placement, size, sizeof b[0]);
+   float (*c)[size] = placement_alloc_or_exit (proto->placement, size, size * sizeof c[0][0]);
+   unsigned *perm = malloc (size * sizeof perm[0]);
+   double *ns = malloc (nb_calls * sizeof ns[0]);
+   unsigned *nb_dirty = malloc (nb_calls * sizeof nb_dirty[0]);
+   double *bin = malloc (nb_calls * sizeof bin[0]);
+   struct kernel_ctx ctx;
+
+   init_arrays (size, a, b, c, placement_parallel_init (proto->placement));
+   for (i=0; i<size; i++) perm[i] = i;
+   if (kctx_init (&ctx, size, b, c) != 0) {
+      fprintf (stderr, "Cannot allocate the incremental context\n");
+      goto free_arrays;
+   }
+
+   fprintf (out, "Incremental calls: %u, dirty fraction drawn in [0, %.4f] per call\n",
+            nb_calls, max_fraction);
+   fprintf (out, "Check against one full %s call: max relative difference %.2e\n", res[0].kv->name,
+            check (&ctx, res[0].kv, size, a, b, c, perm, (unsigned) (max_fraction * size)));
+
+   for (i=0; i<proto->repw; i++) {
+      modify (&ctx, size, b, c, perm, (unsigned) (rng_float() * max_fraction * size));
+      kctx_kernel (&ctx, size, a, b, c);
+   }
+
+   for (i=0; i<nb_calls; i++) {
+      nb_dirty[i] = (unsigned) (rng_float() * max_fraction * size);
+      modify (&ctx, size, b, c, perm, nb_dirty[i]);
+
+      const uint64_t t1 = timer->start();
+      kctx_kernel (&ctx, size, a, b, c);
+      const uint64_t t2 = timer->stop();
+      ns[i] = timer_ns (timer, timer_elapsed (timer, t1, t2));
+   }
+
+   /* table binned by dirty fraction, speedups against full calls */
+   fprintf (out, "\n%-17s %8s %14s %16s", "DIRTY FRACTION", "CALLS", "MED (ns/call)", "MED (ns/dirty)");
+   for (v=0; v<nb; v++)
+      fprintf (out, " %9.9s/%-6.6s", "SPEEDUP", res[v].kv->name);
+   fprintf (out, "\n");
+
+   const double width = max_fraction / INCR_NB_BINS;
+   unsigned k;
+   for (k=0; k<INCR_NB_BINS; k++) {
+      unsigned nb_bin = 0;
+      double dirty_sum = 0.0;
+      for (i=0; i<nb_calls; i++) {
+         const unsigned in = (unsigned) ((double) nb_dirty[i] / size / width);
+         if ((in < INCR_NB_BINS ? in : INCR_NB_BINS - 1) != k) continue;
+         bin [nb_bin++] = ns[i];
+         dirty_sum += nb_dirty[i];
+      }
+
+      char range [32];
+      snprintf (range, sizeof range, "[%.4f,%.4f[", k * width, (k+1) * width);
+      if (nb_bin == 0) {
+         fprintf (out, "%-17s %8u\n", range, 0);
+         continue;
+      }
+
+      const double med = stats_median (bin, nb_bin);
+      fprintf (out, "%-17s %8u %14.1f %16.2f", range, nb_bin, med,
+               dirty_sum > 0 ? med / (dirty_sum / nb_bin) : 0.0);
+      for (v=0; v<nb; v++) {
+         const double full_ns = timer_ns (timer, res[v].med) / proto->repm;
+         fprintf (out, " %15.2fx", med > 0 ? full_ns / med : 0.0);
+      }
+      fprintf (out, "\n");
+   }
+
+   fprintf (out, "\nOverall median %.1f ns per incremental call", stats_median (ns, nb_calls));
+   for (v=0; v<nb; v++)
+      fprintf (out, ", %s full call %.1f ns", res[v].kv->name, timer_ns (timer, res[v].med) / proto->repm);
+   fprintf (out, "\n");
+
+   kctx_free (&ctx);
+free_arrays:
+   free (perm);
+   free (ns);
+   free (nb_dirty);
+   free (bin);
+   placement_free (proto->placement, a, size, sizeof a[0]);
+   placement_free (proto->placement, b, size, sizeof b[0]);
+   placement_free (proto->placement, c, size, size * sizeof c[0][0]);
+}
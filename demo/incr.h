@@ -0,0 +1,24 @@
+#ifndef INCR_H
+#define INCR_H
+
+#include <stdio.h>
+
+#include "bench.h"
+
+/* Incremental mode of the measure driver: the cached row-sum context (kctx)
+   is called repeatedly while a random fraction of the rows of c and entries
+   of b, drawn uniformly in [0, max fraction] for each call, is modified
+   between calls (outside the timed region). Times per call are binned by
+   dirty fraction and compared with full calls of the selected variants */
+
+#define INCR_NB_BINS 10
+
+/* Fraction in ]0, 1]. Returns -1 if invalid */
+int incr_parse (const char *str, double *max_fraction);
+
+/* proto->nb_metas * proto->repm incremental calls after proto->repw warmup
+   calls; full variants measured with the usual protocol */
+void incr_run (struct variant_result res[], unsigned nb, const struct protocol *proto,
+               double max_fraction, FILE *out);
+
+#endif
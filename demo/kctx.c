@@ -0,0 +1,84 @@
+#include <stdlib.h> // malloc, calloc
+
+#include "kctx.h"
+
+static float row_sum (unsigned n, const float *x) {
+   float sum = 0.0f;
+   unsigned j;
+
+   #pragma omp simd reduction(+:sum)
+   for (j=0; j<n; j++)
+      sum += x[j];
+
+   return sum;
+}
+
+int kctx_init (struct kernel_ctx *ctx, unsigned n, float b[n], float c[n][n]) {
+   unsigned i;
+
+   ctx->n = n;
+   ctx->row_sums = malloc (n * sizeof ctx->row_sums[0]);
+   ctx->inv_b = malloc (n * sizeof ctx->inv_b[0]);
+   ctx->flags = calloc (n, sizeof ctx->flags[0]);
+   ctx->dirty = malloc (n * sizeof ctx->dirty[0]);
+   ctx->nb_dirty = 0;
+   if (ctx->row_sums == NULL || ctx->inv_b == NULL || ctx->flags == NULL || ctx->dirty == NULL) {
+      kctx_free (ctx);
+      return -1;
+   }
+
+   #pragma omp parallel for
+   for (i=0; i<n; i++) {
+      ctx->row_sums[i] = row_sum (n, c[i]);
+      ctx->inv_b[i] = 1.0f / b[i];
+   }
+
+   return 0;
+}
+
+static void mark (struct kernel_ctx *ctx, unsigned i, unsigned char flag) {
+   if (ctx->flags[i] == 0) ctx->dirty [ctx->nb_dirty++] = i;
+   ctx->flags[i] |= flag;
+}
+
+void kctx_update_row (struct kernel_ctx *ctx, unsigned i) {
+   mark (ctx, i, KCTX_DIRTY_ROW);
+}
+
+void kctx_update_b (struct kernel_ctx *ctx, unsigned i) {
+   mark (ctx, i, KCTX_DIRTY_B);
+}
+
+void kctx_kernel (struct kernel_ctx *ctx, unsigned n, float a[n], float b[n], float c[n][n]) {
+   const unsigned nb_dirty = ctx->nb_dirty;
+   unsigned k, i;
+
+   #pragma omp parallel
+   {
+      /* dirty rows, dynamic: a few full rows may be spread unevenly */
+      #pragma omp for schedule(dynamic, 4)
+      for (k=0; k<nb_dirty; k++) {
+         const unsigned r = ctx->dirty[k];
+         if (ctx->flags[r] & KCTX_DIRTY_ROW) ctx->row_sums[r] = row_sum (n, c[r]);
+         if (ctx->flags[r] & KCTX_DIRTY_B) ctx->inv_b[r] = 1.0f / b[r];
+         ctx->flags[r] = 0;
+      }
+
+      #pragma omp for simd schedule(static)
+      for (i=0; i<n; i++)
+         a[i] += ctx->row_sums[i] * ctx->inv_b[i];
+   }
+
+   ctx->nb_dirty = 0;
+}
+
+void kctx_free (struct kernel_ctx *ctx) {
+   free (ctx->row_sums);
+   free (ctx->inv_b);
+   free (ctx->flags);
+   free (ctx->dirty);
+   ctx->row_sums = NULL;
+   ctx->inv_b = NULL;
+   ctx->flags = NULL;
+   ctx->dirty = NULL;
+}
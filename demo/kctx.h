@@ -0,0 +1,34 @@
+#ifndef KCTX_H
+#define KCTX_H
+
+/* Stateful kernel for repeated calls on mostly unchanged inputs: row sums of
+   c and reciprocals of b are cached, and only the rows declared modified
+   through the update API are rescanned. A call costs O(n + dirty * n)
+   instead of O(n * n). TODO: adjust for each kernel */
+
+struct kernel_ctx {
+   unsigned n;
+   float *row_sums;      /* sum of c[i][*] */
+   float *inv_b;         /* 1 / b[i] */
+   unsigned char *flags; /* KCTX_DIRTY_* per row */
+   unsigned *dirty;      /* rows with flags set, in update order */
+   unsigned nb_dirty;
+};
+
+#define KCTX_DIRTY_ROW 1 /* c[i][*] modified */
+#define KCTX_DIRTY_B   2 /* b[i] modified */
+
+/* Full scan of b and c. Returns -1 on allocation failure */
+int kctx_init (struct kernel_ctx *ctx, unsigned n, float b[n], float c[n][n]);
+
+/* Declares c[i][*] (row) or b[i] (b) modified since the last call */
+void kctx_update_row (struct kernel_ctx *ctx, unsigned i);
+void kctx_update_b (struct kernel_ctx *ctx, unsigned i);
+
+/* Same result as kernel (n, a, b, c): rescans the dirty rows, then
+   a[i] += row_sums[i] * inv_b[i] */
+void kctx_kernel (struct kernel_ctx *ctx, unsigned n, float a[n], float b[n], float c[n][n]);
+
+void kctx_free (struct kernel_ctx *ctx);
+
+#endif
@@ -1,3 +1,9 @@
+/* Symbol of the variant: the Makefile overrides it to build every variant
+   into the same binary (kernel_noopt, kernel_opt1...), see kernels.c */
+#ifndef KERNEL_NAME
+#define KERNEL_NAME kernel
+#endif
+
 #ifdef OPT1
 
 /* Removing of store to load dependency (array ref replaced by scalar) */
@@ -5,7 +11,7 @@
 // n x n, row-major float matrix c
 // vectors a, b each of length n
 // We assume c is not constant across calls; otherwise, consider precomputing sums.
-void kernel(unsigned n, float a[n], float b[n], float c[n][n]) {
+void KERNEL_NAME (unsigned n, float a[n], float b[n], float c[n][n]) {
 #pragma omp parallel for  // parallelize over i
     for (unsigned i = 0; i < n; i++) {
         float temp  = a[i];
@@ -28,7 +34,7 @@ void kernel(unsigned n, float a[n], float b[n], float c[n][n]) {
 #include <string.h> // memset
 //#include <immintrin.h> // For AVX/SSE intrinsics
 
-void kernel(unsigned n, float a[n], float b[n], float c[n][n]) {
+void KERNEL_NAME (unsigned n, float a[n], float b[n], float c[n][n]) {
     unsigned i, j;
 
     for (i = 0; i < n; i++) {
@@ -45,10 +51,168 @@ void kernel(unsigned n, float a[n], float b[n], float c[n][n]) {
     }
 }
 
+#elif defined SIMD_SSE2 || defined SIMD_AVX2 || defined SIMD_AVX512
+
+/* Explicit SIMD row sums with NB_ACC independent vector accumulators to hide
+   the FP add latency. Each variant is built with its own -m flags (see
+   Makefile) and only run on hosts supporting them, see kernels_select_isa */
+#if defined __SSE2__
+#include <immintrin.h>
+#endif
+
+#define NB_ACC 4
+
+#if defined SIMD_AVX512 && defined __AVX512F__
+
+static float row_sum (unsigned n, const float *x) {
+    __m512 acc0 = _mm512_setzero_ps (), acc1 = _mm512_setzero_ps ();
+    __m512 acc2 = _mm512_setzero_ps (), acc3 = _mm512_setzero_ps ();
+    unsigned j;
+
+    for (j = 0; j + NB_ACC * 16 <= n; j += NB_ACC * 16) {
+        acc0 = _mm512_add_ps (acc0, _mm512_loadu_ps (x + j));
+        acc1 = _mm512_add_ps (acc1, _mm512_loadu_ps (x + j + 16));
+        acc2 = _mm512_add_ps (acc2, _mm512_loadu_ps (x + j + 32));
+        acc3 = _mm512_add_ps (acc3, _mm512_loadu_ps (x + j + 48));
+    }
+    for (; j + 16 <= n; j += 16)
+        acc0 = _mm512_add_ps (acc0, _mm512_loadu_ps (x + j));
+    // masked load of the remaining elements
+    if (j < n)
+        acc1 = _mm512_add_ps (acc1, _mm512_maskz_loadu_ps ((__mmask16) ((1U << (n - j)) - 1), x + j));
+
+    return _mm512_reduce_add_ps (_mm512_add_ps (_mm512_add_ps (acc0, acc1), _mm512_add_ps (acc2, acc3)));
+}
+
+#elif (defined SIMD_AVX2 && defined __AVX2__) || (defined SIMD_SSE2 && defined __SSE2__)
+
+static float hsum128 (__m128 v) {
+    v = _mm_add_ps (v, _mm_movehl_ps (v, v));
+    v = _mm_add_ss (v, _mm_shuffle_ps (v, v, 1));
+    return _mm_cvtss_f32 (v);
+}
+
+#ifdef SIMD_AVX2
+#define VEC         __m256
+#define VEC_WIDTH   8
+#define VEC_ZERO    _mm256_setzero_ps
+#define VEC_ADD     _mm256_add_ps
+#define VEC_LOAD    _mm256_loadu_ps
+#define VEC_HSUM(v) hsum128 (_mm_add_ps (_mm256_castps256_ps128 (v), _mm256_extractf128_ps (v, 1)))
+#else
+#define VEC         __m128
+#define VEC_WIDTH   4
+#define VEC_ZERO    _mm_setzero_ps
+#define VEC_ADD     _mm_add_ps
+#define VEC_LOAD    _mm_loadu_ps
+#define VEC_HSUM(v) hsum128 (v)
+#endif
+
+static float row_sum (unsigned n, const float *x) {
+    VEC acc0 = VEC_ZERO (), acc1 = VEC_ZERO (), acc2 = VEC_ZERO (), acc3 = VEC_ZERO ();
+    unsigned j;
+
+    for (j = 0; j + NB_ACC * VEC_WIDTH <= n; j += NB_ACC * VEC_WIDTH) {
+        acc0 = VEC_ADD (acc0, VEC_LOAD (x + j));
+        acc1 = VEC_ADD (acc1, VEC_LOAD (x + j + VEC_WIDTH));
+        acc2 = VEC_ADD (acc2, VEC_LOAD (x + j + 2 * VEC_WIDTH));
+        acc3 = VEC_ADD (acc3, VEC_LOAD (x + j + 3 * VEC_WIDTH));
+    }
+    for (; j + VEC_WIDTH <= n; j += VEC_WIDTH)
+        acc0 = VEC_ADD (acc0, VEC_LOAD (x + j));
+
+    float sum = VEC_HSUM (VEC_ADD (VEC_ADD (acc0, acc1), VEC_ADD (acc2, acc3)));
+    for (; j < n; j++)
+        sum += x[j];
+
+    return sum;
+}
+
+#else
+
+/* non-x86 builds: same accumulator structure, left to the compiler */
+static float row_sum (unsigned n, const float *x) {
+    float acc [NB_ACC] = { 0.0f };
+    unsigned j, k;
+
+    for (j = 0; j + NB_ACC <= n; j += NB_ACC)
+        for (k = 0; k < NB_ACC; k++)
+            acc[k] += x[j+k];
+    for (; j < n; j++)
+        acc[0] += x[j];
+
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+#endif
+
+void KERNEL_NAME (unsigned n, float a[n], float b[n], float c[n][n]) {
+#pragma omp parallel for
+    for (unsigned i = 0; i < n; i++)
+        a[i] += row_sum (n, c[i]) / b[i];
+}
+
+#elif defined KAHAN
+
+/* Compensated (Kahan) row sums in KAHAN_NV independent vectors of sums and
+   compensations (GCC vector extensions, no ISA flag needed): the dependency
+   chain of each lane is 4 adds long, so enough vectors keep the adders busy.
+   Lanes are then merged with the same compensation. Must not be built with
+   -ffast-math, which would cancel the compensation */
+#include <string.h> // memcpy
+
+typedef float kahan_vec __attribute__ ((vector_size (16)));
+
+#define KAHAN_NV 8
+#define KAHAN_W  (sizeof (kahan_vec) / sizeof (float))
+
+static float row_sum (unsigned n, const float *x) {
+    kahan_vec sum [KAHAN_NV], comp [KAHAN_NV];
+    unsigned j, k;
+
+    for (k = 0; k < KAHAN_NV; k++) {
+        sum[k] = (kahan_vec) { 0.0f };
+        comp[k] = (kahan_vec) { 0.0f };
+    }
+
+    for (j = 0; j + KAHAN_NV * KAHAN_W <= n; j += KAHAN_NV * KAHAN_W) {
+        for (k = 0; k < KAHAN_NV; k++) {
+            kahan_vec v;
+            memcpy (&v, x + j + k * KAHAN_W, sizeof v); // unaligned load
+            const kahan_vec y = v - comp[k];
+            const kahan_vec t = sum[k] + y;
+            comp[k] = (t - sum[k]) - y;
+            sum[k] = t;
+        }
+    }
+
+    float s = 0.0f, c = 0.0f;
+    for (k = 0; k < KAHAN_NV * KAHAN_W; k++) {
+        const float y = (sum [k / KAHAN_W][k % KAHAN_W] - comp [k / KAHAN_W][k % KAHAN_W]) - c;
+        const float t = s + y;
+        c = (t - s) - y;
+        s = t;
+    }
+    for (; j < n; j++) {
+        const float y = x[j] - c;
+        const float t = s + y;
+        c = (t - s) - y;
+        s = t;
+    }
+
+    return s;
+}
+
+void KERNEL_NAME (unsigned n, float a[n], float b[n], float c[n][n]) {
+#pragma omp parallel for
+    for (unsigned i = 0; i < n; i++)
+        a[i] += row_sum (n, c[i]) / b[i];
+}
+
 #else
 
 /* original */
-void kernel (unsigned n, float a[n], float b[n], float c[n][n]) {
+void KERNEL_NAME (unsigned n, float a[n], float b[n], float c[n][n]) {
 	unsigned i , j ;
 	for ( j =0; j < n ; j ++)
 		for ( i =0; i < n ; i ++)
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h> // abort
+#include <string.h> // strcmp, strrchr
+#include <dlfcn.h>  // dlopen, dlsym
+
+#include "kernels.h"
+
+#ifndef DEFAULT_KERNEL
+#define DEFAULT_KERNEL "NOOPT"
+#endif
+
+/* Built-in variants: kernel.c compiled once per OPT value, see Makefile */
+extern void kernel_noopt (unsigned n, float a[n], float b[n], float c[n][n]);
+extern void kernel_opt1  (unsigned n, float a[n], float b[n], float c[n][n]);
+extern void kernel_opt2  (unsigned n, float a[n], float b[n], float c[n][n]);
+extern void kernel_sse2  (unsigned n, float a[n], float b[n], float c[n][n]);
+extern void kernel_avx2  (unsigned n, float a[n], float b[n], float c[n][n]);
+extern void kernel_avx512 (unsigned n, float a[n], float b[n], float c[n][n]);
+extern void kernel_kahan (unsigned n, float a[n], float b[n], float c[n][n]);
+
+static void simd_resolve (unsigned n, float a[n], float b[n], float c[n][n]);
+
+/* Costs, TODO: adjust for each kernel. Row sums of c, then a[i] += sum * (1 / b[i]) */
+static void cost_row_sums (unsigned n, struct kernel_cost *cost) {
+   cost->flops = (double) n * n + 2.0 * n;
+   cost->bytes = ((double) n * n + 3.0 * n) * sizeof (float); /* c and b read, a read and written */
+   cost->elems = (double) n * n;
+}
+
+/* Compensated sums: 4 operations per element of c */
+static void cost_kahan (unsigned n, struct kernel_cost *cost) {
+   cost_row_sums (n, cost);
+   cost->flops = 4.0 * n * n + 2.0 * n;
+}
+
+#define SIMD_INDEX 6
+
+static struct kernel_variant variants [KERNELS_MAX] = {
+   { "NOOPT",  kernel_noopt,  NULL, NULL,     cost_row_sums },
+   { "OPT1",   kernel_opt1,   NULL, NULL,     cost_row_sums },
+   { "OPT2",   kernel_opt2,   NULL, NULL,     cost_row_sums },
+   { "SSE2",   kernel_sse2,   NULL, "sse2",   cost_row_sums },
+   { "AVX2",   kernel_avx2,   NULL, "avx2",   cost_row_sums },
+   { "AVX512", kernel_avx512, NULL, "avx512", cost_row_sums },
+   { "SIMD",   simd_resolve,  NULL, NULL,     cost_row_sums }, /* SIMD_INDEX */
+   { "KAHAN",  kernel_kahan,  NULL, NULL,     cost_kahan },
+};
+static unsigned nb_variants = 8;
+
+/* Widest first */
+static const struct {
+   const char *isa;
+   unsigned variant;
+} isas[] = { { "avx512", 5 }, { "avx2", 4 }, { "sse2", 3 } };
+
+static const char *selected_isa = NULL;
+
+int kernels_isa_supported (const char *isa) {
+#if defined __i386 || defined __amd64
+   __builtin_cpu_init ();
+   if (strcmp (isa, "avx512") == 0) return __builtin_cpu_supports ("avx512f");
+   if (strcmp (isa, "avx2") == 0) return __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma");
+   if (strcmp (isa, "sse2") == 0) return __builtin_cpu_supports ("sse2");
+   return 0;
+#else
+   (void) isa;
+   return 1; /* generic C builds of the SIMD variants */
+#endif
+}
+
+int kernels_supported (const struct kernel_variant *kv) {
+   return kv->isa == NULL || kernels_isa_supported (kv->isa);
+}
+
+int kernels_select_isa (const char *isa) {
+   unsigned i;
+
+   for (i=0; i<sizeof isas / sizeof isas[0]; i++) {
+      if (isa != NULL && strcmp (isa, isas[i].isa) != 0) continue;
+      if (!kernels_isa_supported (isas[i].isa)) {
+         if (isa == NULL) continue;
+         fprintf (stderr, "ISA %s is not supported by this CPU\n", isa);
+         return -1;
+      }
+      variants [SIMD_INDEX].fn = variants [isas[i].variant].fn;
+      selected_isa = isas[i].isa;
+      return 0;
+   }
+
+   if (isa != NULL)
+      fprintf (stderr, "Unknown ISA %s (avx512, avx2 or sse2)\n", isa);
+   else
+      fprintf (stderr, "No SIMD variant supported by this CPU\n");
+   return -1;
+}
+
+const char *kernels_selected_isa (void) {
+   if (selected_isa == NULL) kernels_select_isa (NULL);
+
+   return selected_isa;
+}
+
+/* First call of SIMD without kernels_select_isa: binds the widest variant */
+static void simd_resolve (unsigned n, float a[n], float b[n], float c[n][n]) {
+   if (kernels_selected_isa() == NULL) abort ();
+   variants [SIMD_INDEX].fn (n, a, b, c);
+}
+
+unsigned kernels_count (void) {
+   return nb_variants;
+}
+
+const struct kernel_variant *kernels_get (unsigned i) {
+   return i < nb_variants ? &variants[i] : NULL;
+}
+
+static struct kernel_variant *find_variant (const char *name) {
+   unsigned i;
+
+   for (i=0; i<nb_variants; i++)
+      if (strcmp (variants[i].name, name) == 0)
+         return &variants[i];
+
+   return NULL;
+}
+
+const struct kernel_variant *kernels_find (const char *name) {
+   const struct kernel_variant *v = find_variant (name);
+
+   if (v != NULL && !kernels_supported (v)) {
+      fprintf (stderr, "Kernel variant %s needs %s, not supported by this CPU\n", name, v->isa);
+      return NULL;
+   }
+
+   return v;
+}
+
+const struct kernel_variant *kernels_default (void) {
+   const struct kernel_variant *v = find_variant (DEFAULT_KERNEL);
+
+   return v != NULL && kernels_supported (v) ? v : &variants[0];
+}
+
+void kernels_cost (const struct kernel_variant *kv, unsigned n, struct kernel_cost *cost) {
+   kv->cost (n, cost);
+}
+
+const struct kernel_variant *kernels_load_plugin (const char *path) {
+   if (nb_variants == KERNELS_MAX) {
+      fprintf (stderr, "Cannot load %s: too many kernel variants (max %d)\n", path, KERNELS_MAX);
+      return NULL;
+   }
+
+   void *handle = dlopen (path, RTLD_NOW | RTLD_LOCAL);
+   if (handle == NULL) {
+      fprintf (stderr, "Cannot load %s: %s\n", path, dlerror ());
+      return NULL;
+   }
+
+   kernel_fn_t fn = (kernel_fn_t) dlsym (handle, "kernel");
+   if (fn == NULL) {
+      fprintf (stderr, "Cannot load %s: no kernel symbol\n", path);
+      dlclose (handle);
+      return NULL;
+   }
+
+   /* name: file basename without .so suffix */
+   const char *base = strrchr (path, '/');
+   char *name = strdup (base != NULL ? base + 1 : path);
+   char *ext = strstr (name, ".so");
+   if (ext != NULL && ext != name) *ext = '\0';
+
+   if (find_variant (name) != NULL) {
+      fprintf (stderr, "Cannot load %s: variant %s already registered\n", path, name);
+      free (name);
+      dlclose (handle);
+      return NULL;
+   }
+
+   struct kernel_variant *v = &variants [nb_variants++];
+   v->name = name;
+   v->fn = fn;
+   v->handle = handle;
+   v->isa = NULL;
+   v->cost = (kernel_cost_fn_t) dlsym (handle, "kernel_cost");
+   if (v->cost == NULL) v->cost = cost_row_sums;
+
+   return v;
+}
+
+void kernels_unload_plugins (void) {
+   unsigned i;
+
+   for (i=0; i<nb_variants; i++) {
+      if (variants[i].handle == NULL) continue;
+      dlclose (variants[i].handle);
+      free ((char *) variants[i].name);
+   }
+
+   /* keep built-in variants only */
+   unsigned j = 0;
+   for (i=0; i<nb_variants; i++)
+      if (variants[i].handle == NULL)
+         variants[j++] = variants[i];
+   nb_variants = j;
+}
@@ -0,0 +1,69 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+/* Kernel registry: every variant of kernel.c built into the binary under its
+   own symbol, plus variants loaded at run time from shared objects */
+
+// TODO: adjust for each kernel
+typedef void (*kernel_fn_t) (unsigned n, float a[n], float b[n], float c[n][n]);
+
+/* Work of one call at size n, from which the drivers derive GFLOP/s,
+   effective GB/s, arithmetic intensity and time per element */
+struct kernel_cost {
+   double flops; /* floating-point operations */
+   double bytes; /* compulsory memory traffic: each array read (and written) once */
+   double elems; /* elements processed, the unit of the per-element figures */
+};
+
+// TODO: adjust for each kernel
+typedef void (*kernel_cost_fn_t) (unsigned n, struct kernel_cost *cost);
+
+struct kernel_variant {
+   const char *name; /* NOOPT, OPT1... or plugin file basename */
+   kernel_fn_t fn;
+   void *handle;     /* dlopen handle, NULL for built-in variants */
+   const char *isa;  /* instruction set the variant needs, NULL if portable */
+   kernel_cost_fn_t cost;
+};
+
+#define KERNELS_MAX 64
+
+/* Number of registered variants and access by index or name. kernels_find
+   returns NULL if the host lacks the instruction set of the variant (reported
+   on stderr) */
+unsigned kernels_count (void);
+const struct kernel_variant *kernels_get (unsigned i);
+const struct kernel_variant *kernels_find (const char *name);
+
+/* Explicit SIMD variants SSE2, AVX2 (with FMA) and AVX512 run only where cpuid
+   reports their instruction set; SIMD is bound to the widest one */
+int kernels_supported (const struct kernel_variant *kv);
+
+/* cpuid check of "sse2", "avx2" (with FMA) or "avx512", always true on other
+   architectures where the SIMD variants are generic C */
+int kernels_isa_supported (const char *isa);
+
+/* Binds SIMD to the variant of isa ("sse2", "avx2" or "avx512"), or to the
+   widest supported one if isa is NULL. Returns -1 (reported on stderr) if
+   isa is unknown or unsupported */
+int kernels_select_isa (const char *isa);
+
+/* ISA SIMD is bound to, selecting the widest one on first use */
+const char *kernels_selected_isa (void);
+
+/* Variant selected at build time with make OPT=... */
+const struct kernel_variant *kernels_default (void);
+
+/* Cost of one call of kv at size n */
+void kernels_cost (const struct kernel_variant *kv, unsigned n, struct kernel_cost *cost);
+
+/* Loads a shared object exporting a "kernel" symbol and registers it under
+   the file basename (without .so). A "kernel_cost" symbol (kernel_cost_fn_t)
+   declares its cost, the one of the built-in variants otherwise. Returns NULL
+   on error (reported on stderr) */
+const struct kernel_variant *kernels_load_plugin (const char *path);
+
+/* dlclose all plugins */
+void kernels_unload_plugins (void);
+
+#endif
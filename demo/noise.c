@@ -0,0 +1,251 @@
+#define _GNU_SOURCE // sched_setaffinity, CPU_SET
+#include <stdio.h>
+#include <stdlib.h>   // getloadavg, strtol
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>   // strcmp, strcspn, strerror
+#include <errno.h>
+#include <time.h>     // clock_gettime
+#include <sched.h>    // sched_setaffinity, sched_setscheduler
+#include <sys/resource.h> // setpriority
+
+#include "noise.h"
+#include "rdtsc.h"
+
+#define CPU_DIR "/sys/devices/system/cpu"
+#define LOAD_THRESHOLD 0.5
+#define FREQ_DRIFT 0.05
+#define FREQ_NB_ADDS (8 * 1000 * 1000) /* dependent adds per estimate */
+
+static void add (struct noise_report *r, const char *name, int suspect, const char *fmt, ...) {
+   va_list ap;
+
+   if (r->nb == NOISE_MAX_FINDINGS) return;
+   struct noise_finding *f = &r->findings [r->nb++];
+   snprintf (f->name, sizeof f->name, "%s", name);
+   f->suspect = suspect;
+   va_start (ap, fmt);
+   vsnprintf (f->value, sizeof f->value, fmt, ap);
+   va_end (ap);
+}
+
+/* First line of a sysfs file without its newline. Returns -1 if not readable */
+static int read_line (const char *path, char *buf, size_t len) {
+   FILE *fp = fopen (path, "r");
+   if (fp == NULL) return -1;
+
+   const int ok = fgets (buf, len, fp) != NULL;
+   fclose (fp);
+   if (!ok) buf[0] = '\0';
+   buf [strcspn (buf, "\n")] = '\0';
+
+   return 0;
+}
+
+static void check_governors (struct noise_report *r) {
+   static struct cpu_info cpus [TOPO_MAX_CPUS];
+   const unsigned nb_cpus = topo_cpus (cpus);
+   char path [128], gov [64], first [64] = "";
+   unsigned i, nb_read = 0, nb_other = 0;
+
+   for (i=0; i<nb_cpus; i++) {
+      snprintf (path, sizeof path, CPU_DIR "/cpu%u/cpufreq/scaling_governor", cpus[i].cpu);
+      if (read_line (path, gov, sizeof gov) != 0) continue;
+      if (nb_read++ == 0) snprintf (first, sizeof first, "%s", gov);
+      if (strcmp (gov, "performance") != 0) nb_other++;
+   }
+
+   if (nb_read == 0)
+      add (r, "governor", 0, "unknown (no cpufreq in sysfs, e.g. virtual machine)");
+   else if (nb_other > 0)
+      add (r, "governor", 1, "%s on cpu%u, %u/%u CPUs not on performance: frequency scaling",
+           first, cpus[0].cpu, nb_other, nb_read);
+   else
+      add (r, "governor", 0, "performance on %u CPUs", nb_read);
+}
+
+static void check_turbo (struct noise_report *r) {
+   char buf [16];
+
+   /* intel_pstate reports the opposite of acpi-cpufreq */
+   if (read_line (CPU_DIR "/intel_pstate/no_turbo", buf, sizeof buf) == 0)
+      add (r, "turbo", buf[0] == '0', buf[0] == '0' ? "enabled (intel_pstate): frequency depends on"
+           " load and temperature" : "disabled (intel_pstate)");
+   else if (read_line (CPU_DIR "/cpufreq/boost", buf, sizeof buf) == 0)
+      add (r, "turbo", buf[0] == '1', buf[0] == '1' ? "enabled (cpufreq boost): frequency depends on"
+           " load and temperature" : "disabled (cpufreq boost)");
+   else
+      add (r, "turbo", 0, "unknown");
+}
+
+static void check_load (struct noise_report *r) {
+   double load [3];
+
+   if (getloadavg (load, 3) < 1) {
+      add (r, "load", 0, "unknown");
+      return;
+   }
+   add (r, "load", load[0] > LOAD_THRESHOLD, "%.2f %.2f %.2f (1, 5, 15 min)%s", load[0], load[1], load[2],
+        load[0] > LOAD_THRESHOLD ? ": other jobs are running" : "");
+}
+
+static void check_isolated (struct noise_report *r) {
+   static unsigned isolated [TOPO_MAX_CPUS];
+   char buf [NOISE_VALUE_LEN];
+   unsigned i, j, nb_outside = 0;
+
+   if (read_line (CPU_DIR "/isolated", buf, sizeof buf) != 0) {
+      add (r, "isolated CPUs", 0, "unknown");
+      return;
+   }
+   const unsigned nb = topo_parse_list (buf, isolated, TOPO_MAX_CPUS);
+
+   for (i=0; i<r->nb_pinned; i++) {
+      for (j=0; j<nb && isolated[j] != r->pinned[i]; j++);
+      if (j == nb) nb_outside++;
+   }
+
+   if (nb == 0)
+      add (r, "isolated CPUs", 0, "none (isolcpus not set)");
+   else if (nb_outside > 0)
+      add (r, "isolated CPUs", 1, "%s, %u pinned CPUs outside them: shared with other tasks", buf, nb_outside);
+   else
+      add (r, "isolated CPUs", 0, "%s%s", buf, r->nb_pinned > 0 ? ", pinned inside them" : "");
+}
+
+static void check_smt (struct noise_report *r) {
+   char buf [16];
+
+   if (read_line (CPU_DIR "/smt/active", buf, sizeof buf) != 0)
+      add (r, "SMT", 0, "unknown");
+   else
+      add (r, "SMT", buf[0] == '1', buf[0] == '1' ? "active: a sibling hardware thread may share the core"
+           : "inactive");
+}
+
+void noise_check (struct noise_report *r) {
+   check_governors (r);
+   check_turbo (r);
+   check_load (r);
+   check_isolated (r);
+   check_smt (r);
+}
+
+int noise_pin (struct noise_report *r, const char *cpus) {
+   cpu_set_t set;
+   unsigned i;
+
+   r->nb_pinned = topo_parse_list (cpus, r->pinned, TOPO_MAX_CPUS);
+   if (r->nb_pinned == 0) return -1;
+
+   CPU_ZERO (&set);
+   for (i=0; i<r->nb_pinned; i++) {
+      if (r->pinned[i] >= CPU_SETSIZE) return -1;
+      CPU_SET (r->pinned[i], &set);
+   }
+   if (sched_setaffinity (0, sizeof set, &set) != 0) {
+      fprintf (stderr, "Cannot pin on CPUs %s: %s\n", cpus, strerror (errno));
+      r->nb_pinned = 0;
+      return -1;
+   }
+   add (r, "pinning", 0, "process pinned on CPUs %s (sched_setaffinity)", cpus);
+
+   return 0;
+}
+
+int noise_priority (struct noise_report *r, const char *how) {
+   if (strcmp (how, "fifo") == 0) {
+      const struct sched_param param = { .sched_priority = sched_get_priority_min (SCHED_FIFO) };
+      if (sched_setscheduler (0, SCHED_FIFO, &param) != 0)
+         add (r, "priority", 1, "SCHED_FIFO refused: %s", strerror (errno));
+      else
+         add (r, "priority", 0, "SCHED_FIFO, priority %d", param.sched_priority);
+      return 0;
+   }
+
+   char *end;
+   const long nice = strtol (how, &end, 10);
+   if (*end != '\0' || end == how || nice < -20 || nice > 19) return -1;
+   if (setpriority (PRIO_PROCESS, 0, nice) != 0)
+      add (r, "priority", 1, "nice %ld refused: %s", nice, strerror (errno));
+   else
+      add (r, "priority", 0, "nice %ld", nice);
+
+   return 0;
+}
+
+static double now_ns (void) {
+   struct timespec ts;
+   clock_gettime (CLOCK_MONOTONIC_RAW, &ts);
+   return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Chain of dependent register-register adds, one per cycle: the increment
+   is opaque to the compiler and to the immediate folding of recent cores,
+   the empty asm keeps the adds from being merged */
+static uint64_t add_chain (uint64_t nb) {
+   uint64_t x = 0, one = 1, i;
+
+   __asm__ volatile ("" : "+r" (one));
+   for (i=0; i<nb; i+=8) {
+      x += one; __asm__ volatile ("" : "+r" (x));
+      x += one; __asm__ volatile ("" : "+r" (x));
+      x += one; __asm__ volatile ("" : "+r" (x));
+      x += one; __asm__ volatile ("" : "+r" (x));
+      x += one; __asm__ volatile ("" : "+r" (x));
+      x += one; __asm__ volatile ("" : "+r" (x));
+      x += one; __asm__ volatile ("" : "+r" (x));
+      x += one; __asm__ volatile ("" : "+r" (x));
+   }
+
+   return x;
+}
+
+void noise_frequency (struct noise_report *r, const char *label) {
+   char name [32];
+   double best_ns = 0.0, tsc_ghz = 0.0;
+   unsigned t;
+
+   add_chain (FREQ_NB_ADDS / 4); /* ramps the core up */
+
+   /* best of 3: interrupts only lengthen a trial */
+   for (t=0; t<3; t++) {
+      const double t0 = now_ns();
+      const uint64_t c0 = rdtsc();
+      add_chain (FREQ_NB_ADDS);
+      const uint64_t c1 = rdtsc();
+      const double ns = now_ns() - t0;
+      if (best_ns == 0.0 || ns < best_ns) {
+         best_ns = ns;
+         tsc_ghz = (c1 - c0) / ns;
+      }
+   }
+
+   const double ghz = FREQ_NB_ADDS / best_ns;
+   snprintf (name, sizeof name, "frequency %s", label);
+   if (r->first_ghz == 0.0) r->first_ghz = ghz;
+   r->ghz = ghz;
+   const double drift = ghz / r->first_ghz - 1;
+   const int suspect = drift > FREQ_DRIFT || drift < -FREQ_DRIFT;
+
+#if defined __i386 || defined __amd64
+   add (r, name, suspect, "%.2f GHz effective (TSC %.2f GHz, ratio %.2f)%s", ghz, tsc_ghz, ghz / tsc_ghz,
+        suspect ? ": drifted since the first estimate" : "");
+#else
+   (void) tsc_ghz;
+   add (r, name, suspect, "%.2f GHz effective%s", ghz, suspect ? ": drifted since the first estimate" : "");
+#endif
+}
+
+void noise_print (const struct noise_report *r, FILE *fp) {
+   unsigned i, nb_suspects = 0;
+
+   fprintf (fp, "\nENVIRONMENT CHECKS\n");
+   for (i=0; i<r->nb; i++) {
+      fprintf (fp, "%s %-22s %s\n", r->findings[i].suspect ? "!!" : "  ", r->findings[i].name,
+               r->findings[i].value);
+      nb_suspects += r->findings[i].suspect;
+   }
+   if (nb_suspects > 0)
+      fprintf (fp, "(!!: %u likely noise source%s)\n", nb_suspects, nb_suspects > 1 ? "s" : "");
+}
@@ -0,0 +1,51 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <stdio.h>
+
+#include "topo.h"
+
+/* Noise sources of the measure driver: host checks before measuring
+   (frequency governor, turbo, load, isolated CPUs, SMT), self pinning and
+   priority, and effective core frequency estimates during the run. Each
+   finding is reported next to the results */
+
+#define NOISE_MAX_FINDINGS 32
+#define NOISE_VALUE_LEN 160
+
+struct noise_finding {
+   char name [32];
+   char value [NOISE_VALUE_LEN];
+   int suspect; /* likely source of unstable timings */
+};
+
+struct noise_report {
+   unsigned nb;
+   struct noise_finding findings [NOISE_MAX_FINDINGS];
+   unsigned pinned [TOPO_MAX_CPUS]; /* CPUs of noise_pin, nb_pinned 0 if not pinned */
+   unsigned nb_pinned;
+   double first_ghz;       /* first noise_frequency estimate, 0 before */
+   double ghz;             /* latest estimate, converts times to core cycles */
+};
+
+/* Governor of every online CPU, turbo state, 1-minute load average,
+   isolated CPUs (checked against the pinned ones) and SMT */
+void noise_check (struct noise_report *r);
+
+/* Pins the process (and the OpenMP threads created later) on a CPU list
+   ("2", "2-5,8") with sched_setaffinity. Returns -1 if invalid or refused */
+int noise_pin (struct noise_report *r, const char *cpus);
+
+/* "<nice>" (setpriority) or "fifo" (SCHED_FIFO, lowest real-time priority).
+   A refusal (no CAP_SYS_NICE) is a finding, not an error. Returns -1 if invalid */
+int noise_priority (struct noise_report *r, const char *how);
+
+/* Effective frequency of the calling core from a chain of dependent adds
+   over about 20 ms, recorded as a finding under label. Suspect if it drifts
+   more than 5 % from the first estimate */
+void noise_frequency (struct noise_report *r, const char *label);
+
+/* Findings, suspects flagged */
+void noise_print (const struct noise_report *r, FILE *fp);
+
+#endif
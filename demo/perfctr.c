@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h> // memset
+#include <unistd.h> // syscall, read, close
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <omp.h>
+
+#include "perfctr.h"
+
+struct event_desc {
+   const char *name;
+   uint32_t type;
+   uint64_t config;
+};
+
+#define HW_CACHE(cache, op, result) \
+   ((cache) | ((op) << 8) | ((result) << 16))
+
+static const struct event_desc hw_events[] = {
+   { "cycles",           PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+   { "instructions",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+   { "L1D-load-misses",  PERF_TYPE_HW_CACHE,
+     HW_CACHE (PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+   { "LLC-load-misses",  PERF_TYPE_HW_CACHE,
+     HW_CACHE (PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+   { "branch-misses",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+   { "stalled-cycles",   PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND },
+};
+
+static const struct event_desc sw_events[] = {
+   { "task-clock (ns)",  PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+   { "page-faults",      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+   { "context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+   { "cpu-migrations",   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS },
+};
+
+#define NB_HW_EVENTS (sizeof hw_events / sizeof hw_events[0])
+#define NB_SW_EVENTS (sizeof sw_events / sizeof sw_events[0])
+
+/* Calling thread, any CPU */
+static int open_event (const struct event_desc *ev, int group_fd) {
+   struct perf_event_attr attr;
+
+   memset (&attr, 0, sizeof attr);
+   attr.size = sizeof attr;
+   attr.type = ev->type;
+   attr.config = ev->config;
+   attr.disabled = group_fd == -1; /* members follow the leader */
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                      PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+   return syscall (SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/* Keeps events from the list that can be opened on this host */
+static unsigned select_events (const struct event_desc list[], unsigned nb,
+                               const struct event_desc *selected[PERFCTR_MAX]) {
+   unsigned e, nb_selected = 0;
+
+   for (e=0; e<nb && nb_selected < PERFCTR_MAX; e++) {
+      const int fd = open_event (&list[e], -1);
+      if (fd < 0) continue;
+      close (fd);
+      selected [nb_selected++] = &list[e];
+   }
+
+   return nb_selected;
+}
+
+static void close_all (struct perfctr *pc) {
+   unsigned t, e;
+
+   for (t=0; t<pc->nb_threads; t++)
+      for (e=0; e<pc->nb_events; e++)
+         if (pc->fds[t][e] >= 0) {
+            close (pc->fds[t][e]);
+            pc->fds[t][e] = -1;
+         }
+}
+
+/* One group per thread of the team, the first opened event leads */
+static void open_groups (struct perfctr *pc, const struct event_desc *selected[]) {
+   #pragma omp parallel num_threads (pc->nb_threads)
+   {
+      const unsigned t = omp_get_thread_num();
+      int leader = -1;
+      unsigned e;
+
+      for (e=0; e<pc->nb_events; e++) {
+         pc->fds[t][e] = open_event (selected[e], leader);
+         if (leader < 0) leader = pc->fds[t][e];
+      }
+   }
+}
+
+static int leader_fd (const struct perfctr *pc, unsigned t) {
+   unsigned e;
+
+   for (e=0; e<pc->nb_events; e++)
+      if (pc->fds[t][e] >= 0) return pc->fds[t][e];
+
+   return -1;
+}
+
+/* Group read: nr, time_enabled, time_running, values[nr]. Returns nr or -1 */
+static int read_group (int fd, uint64_t *enabled, uint64_t *running, uint64_t values [PERFCTR_MAX]) {
+   uint64_t buf [3 + PERFCTR_MAX];
+
+   if (read (fd, buf, sizeof buf) < (ssize_t) (3 * sizeof buf[0])) return -1;
+   *enabled = buf[1];
+   *running = buf[2];
+   memcpy (values, &buf[3], buf[0] * sizeof buf[0]);
+
+   return (int) buf[0];
+}
+
+int perfctr_open (struct perfctr *pc) {
+   const struct event_desc *selected [PERFCTR_MAX];
+   unsigned t, e;
+
+   memset (pc, 0, sizeof *pc);
+   pc->nb_events = select_events (hw_events, NB_HW_EVENTS, selected);
+   if (pc->nb_events == 0) {
+      pc->software = 1;
+      pc->nb_events = select_events (sw_events, NB_SW_EVENTS, selected);
+   }
+   if (pc->nb_events == 0) {
+      fprintf (stderr, "No performance counter available (check /proc/sys/kernel/perf_event_paranoid)\n");
+      return -1;
+   }
+
+   pc->nb_threads = omp_get_max_threads();
+   pc->fds = malloc (pc->nb_threads * sizeof pc->fds[0]);
+   for (t=0; t<pc->nb_threads; t++)
+      for (e=0; e<PERFCTR_MAX; e++)
+         pc->fds[t][e] = -1;
+
+   /* Groups larger than the number of hardware counters are never scheduled:
+      drop trailing events until a probe gets counting time */
+   while (pc->nb_events > 0) {
+      open_groups (pc, selected);
+
+      const int fd = leader_fd (pc, 0);
+      uint64_t enabled = 0, running = 0, values [PERFCTR_MAX];
+      if (fd >= 0) {
+         perfctr_start (pc);
+         volatile unsigned spin;
+         for (spin=0; spin<1000000; spin++);
+         ioctl (fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+         read_group (fd, &enabled, &running, values);
+      }
+      if (running > 0) break;
+
+      close_all (pc);
+      pc->nb_events--;
+   }
+   if (pc->nb_events == 0) {
+      fprintf (stderr, "Performance counters cannot be scheduled\n");
+      free (pc->fds);
+      return -1;
+   }
+
+   for (e=0; e<pc->nb_events; e++)
+      pc->names[e] = selected[e]->name;
+
+   return 0;
+}
+
+void perfctr_start (struct perfctr *pc) {
+   unsigned t;
+
+   for (t=0; t<pc->nb_threads; t++) {
+      const int fd = leader_fd (pc, t);
+      if (fd < 0) continue;
+      ioctl (fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl (fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+   }
+}
+
+void perfctr_stop (struct perfctr *pc, uint64_t counts [PERFCTR_MAX]) {
+   unsigned t, e;
+
+   for (t=0; t<pc->nb_threads; t++) {
+      const int fd = leader_fd (pc, t);
+      if (fd >= 0) ioctl (fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+   }
+
+   for (e=0; e<pc->nb_events; e++)
+      counts[e] = 0;
+
+   for (t=0; t<pc->nb_threads; t++) {
+      const int fd = leader_fd (pc, t);
+      uint64_t enabled, running, values [PERFCTR_MAX];
+      if (fd < 0 || read_group (fd, &enabled, &running, values) < 0 || running == 0) continue;
+
+      /* multiplexing: extrapolate to the enabled time */
+      const double scale = (double) enabled / running;
+      if (running < enabled) pc->multiplexed = 1;
+
+      /* values are in group creation order, skipping events not opened on this thread */
+      unsigned slot = 0;
+      for (e=0; e<pc->nb_events; e++)
+         if (pc->fds[t][e] >= 0)
+            counts[e] += (uint64_t) (values [slot++] * scale);
+   }
+}
+
+void perfctr_close (struct perfctr *pc) {
+   close_all (pc);
+   free (pc->fds);
+   pc->fds = NULL;
+}
@@ -0,0 +1,33 @@
+#ifndef PERFCTR_H
+#define PERFCTR_H
+
+#include <stdint.h>
+
+/* Hardware performance counters read as one group per OpenMP thread with
+   perf_event_open, summed over threads. Falls back to software events when
+   no hardware event can be opened (VMs, containers) */
+
+#define PERFCTR_MAX 8
+
+struct perfctr {
+   unsigned nb_events;
+   const char *names [PERFCTR_MAX];
+   int software;        /* 1 if hardware events were unavailable */
+   int multiplexed;     /* 1 if counts had to be scaled (time_running < time_enabled) */
+   unsigned nb_threads;
+   int (*fds)[PERFCTR_MAX]; /* [thread][event], -1 if not opened */
+};
+
+/* Opens counters on each thread of the OpenMP team. Returns -1 (reported on
+   stderr) if neither hardware nor software events are available */
+int perfctr_open (struct perfctr *pc);
+
+/* Resets and enables all counters */
+void perfctr_start (struct perfctr *pc);
+
+/* Disables counters and stores per-event sums over threads in counts */
+void perfctr_stop (struct perfctr *pc, uint64_t counts [PERFCTR_MAX]);
+
+void perfctr_close (struct perfctr *pc);
+
+#endif
@@ -0,0 +1,204 @@
+#define _GNU_SOURCE // sched_setaffinity, CPU_SET
+#include <stdio.h>
+#include <stdlib.h> // exit
+#include <string.h> // strcmp, memset
+#include <sched.h>
+#include <unistd.h> // syscall
+#include <sys/syscall.h>
+#include <linux/mempolicy.h> // MPOL_*
+#include <omp.h>
+
+#include "placement.h"
+
+int placement_parse_pin (const char *str, struct placement *pl) {
+   if (strcmp (str, "none") == 0) pl->pin = PIN_NONE;
+   else if (strcmp (str, "compact") == 0) pl->pin = PIN_COMPACT;
+   else if (strcmp (str, "scatter") == 0) pl->pin = PIN_SCATTER;
+   else return -1;
+
+   return 0;
+}
+
+int placement_parse_mem (const char *str, struct placement *pl) {
+   if (strcmp (str, "default") == 0) pl->mem = MEM_DEFAULT;
+   else if (strcmp (str, "firsttouch") == 0) pl->mem = MEM_FIRST_TOUCH;
+   else if (strcmp (str, "interleave") == 0) pl->mem = MEM_INTERLEAVE;
+   else if (sscanf (str, "bind:%u", &pl->node) == 1) pl->mem = MEM_BIND;
+   else return -1;
+
+   return 0;
+}
+
+int placement_init (struct placement *pl) {
+   static struct cpu_info cpus [TOPO_MAX_CPUS];
+   const unsigned nb = topo_cpus (cpus);
+   unsigned i, rank;
+
+   /* compact: topology order (package, core); scatter: i-th core of each package in turn */
+   pl->nb_cpus = 0;
+   if (pl->pin == PIN_SCATTER) {
+      unsigned max_package = 0;
+      for (i=0; i<nb; i++)
+         if (cpus[i].package > max_package) max_package = cpus[i].package;
+
+      for (rank=0; pl->nb_cpus < nb; rank++) {
+         unsigned added = 0, p;
+         for (p=0; p<=max_package; p++) {
+            unsigned k = 0;
+            for (i=0; i<nb; i++) {
+               if (cpus[i].package != p || (!pl->smt && cpus[i].smt_rank > 0)) continue;
+               if (k++ == rank) {
+                  pl->cpus [pl->nb_cpus++] = cpus[i].cpu;
+                  added++;
+                  break;
+               }
+            }
+         }
+         if (added == 0) break;
+      }
+   } else {
+      for (i=0; i<nb; i++)
+         if (pl->smt || cpus[i].smt_rank == 0)
+            pl->cpus [pl->nb_cpus++] = cpus[i].cpu;
+   }
+
+   pl->alloc = alloc_probe (pl->alloc, stderr);
+
+   pl->nb_nodes = topo_mem_nodes (pl->nodes, TOPO_MAX_CPUS);
+   if (pl->mem == MEM_INTERLEAVE || pl->mem == MEM_BIND) {
+      if (pl->nb_nodes == 0) {
+         fprintf (stderr, "No NUMA node found in sysfs, cannot apply memory policy\n");
+         return -1;
+      }
+      for (i=0; i<pl->nb_nodes; i++)
+         if (pl->mem != MEM_BIND || pl->nodes[i] == pl->node) break;
+      if (i == pl->nb_nodes) {
+         fprintf (stderr, "Node %u has no memory\n", pl->node);
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+void placement_pin_threads (const struct placement *pl) {
+   if (pl->pin == PIN_NONE || pl->nb_cpus == 0) return;
+
+   #pragma omp parallel
+   {
+      cpu_set_t set;
+      CPU_ZERO (&set);
+      CPU_SET (pl->cpus [omp_get_thread_num() % pl->nb_cpus], &set);
+      sched_setaffinity (0, sizeof set, &set);
+   }
+}
+
+#define NODEMASK_BITS 1024
+
+static int apply_mbind (const struct placement *pl, void *addr, size_t len) {
+   unsigned long mask [NODEMASK_BITS / (8 * sizeof (unsigned long))];
+   const unsigned bits = 8 * sizeof mask[0];
+   unsigned i;
+
+   memset (mask, 0, sizeof mask);
+   for (i=0; i<pl->nb_nodes; i++) {
+      const unsigned node = pl->nodes[i];
+      if (node >= NODEMASK_BITS) continue;
+      if (pl->mem == MEM_BIND && node != pl->node) continue;
+      mask [node / bits] |= 1UL << (node % bits);
+   }
+
+   const int mode = pl->mem == MEM_BIND ? MPOL_BIND : MPOL_INTERLEAVE;
+   return syscall (SYS_mbind, addr, len, mode, mask, NODEMASK_BITS + 1, 0);
+}
+
+/* mbind works on whole pages */
+static enum alloc_mode alloc_mode (const struct placement *pl) {
+   if (pl == NULL) return ALLOC_MALLOC;
+   if ((pl->mem == MEM_INTERLEAVE || pl->mem == MEM_BIND) && pl->alloc < ALLOC_PAGE)
+      return ALLOC_PAGE;
+   return pl->alloc;
+}
+
+void *placement_alloc (const struct placement *pl, size_t nb_rows, size_t row_bytes) {
+   const size_t len = nb_rows * row_bytes;
+   size_t i;
+
+   void *p = alloc_array (alloc_mode (pl), len);
+   if (p == NULL || pl == NULL || pl->mem == MEM_DEFAULT) return p;
+
+   /* mbind before any page is touched (the kernel rounds len up to whole pages) */
+   if ((pl->mem == MEM_INTERLEAVE || pl->mem == MEM_BIND) && apply_mbind (pl, p, len) != 0) {
+      static int warned = 0;
+      if (!warned++) perror ("mbind");
+   }
+
+   if (pl->mem == MEM_FIRST_TOUCH) {
+      char *bytes = p;
+      #pragma omp parallel for schedule(static)
+      for (i=0; i<nb_rows; i++)
+         memset (bytes + i * row_bytes, 0, row_bytes);
+   }
+
+   return p;
+}
+
+void *placement_alloc_or_exit (const struct placement *pl, size_t nb_rows, size_t row_bytes) {
+   void *p = placement_alloc (pl, nb_rows, row_bytes);
+
+   if (p == NULL) {
+      fprintf (stderr, "Cannot allocate %zu bytes (%s allocation)\n", nb_rows * row_bytes,
+               alloc_name (alloc_mode (pl)));
+      exit (EXIT_FAILURE);
+   }
+
+   return p;
+}
+
+int placement_parallel_init (const struct placement *pl) {
+   if (pl != NULL && pl->mem != MEM_DEFAULT) return 1;
+   if (pl != NULL) return pl->nb_nodes <= 1;
+
+   static unsigned nodes [TOPO_MAX_CPUS];
+   return topo_mem_nodes (nodes, TOPO_MAX_CPUS) <= 1;
+}
+
+void placement_free (const struct placement *pl, void *p, size_t nb_rows, size_t row_bytes) {
+   alloc_release (alloc_mode (pl), p, nb_rows * row_bytes);
+}
+
+static void print_list (const unsigned *ids, unsigned nb, FILE *fp) {
+   unsigned i;
+
+   for (i=0; i<nb && i<16; i++)
+      fprintf (fp, "%s%u", i > 0 ? "," : "", ids[i]);
+   if (nb > 16) fprintf (fp, ",...");
+}
+
+static const char *pins[] = { "none", "compact", "scatter" };
+static const char *mems[] = { "default", "firsttouch", "interleave", "bind" };
+
+void placement_fingerprint (const struct placement *pl, char *buf, size_t len) {
+   char node [16] = "";
+
+   if (pl->mem == MEM_BIND) snprintf (node, sizeof node, ":%u", pl->node);
+   snprintf (buf, len, "%s%s, memory %s%s", pins [pl->pin],
+             pl->pin != PIN_NONE && pl->smt ? " (with SMT)" : "", mems [pl->mem], node);
+}
+
+void placement_describe (const struct placement *pl, FILE *fp) {
+   fprintf (fp, "Placement: threads %s", pins [pl->pin]);
+   if (pl->pin != PIN_NONE) {
+      fprintf (fp, "%s on CPUs ", pl->smt ? " (with SMT)" : "");
+      print_list (pl->cpus, pl->nb_cpus, fp);
+   }
+   fprintf (fp, "; memory %s", mems [pl->mem]);
+   if (pl->mem == MEM_BIND) fprintf (fp, ":%u", pl->node);
+   fprintf (fp, "; allocation %s", alloc_name (pl->alloc));
+   fprintf (fp, "; nodes with memory ");
+   if (pl->nb_nodes > 0)
+      print_list (pl->nodes, pl->nb_nodes, fp);
+   else
+      fprintf (fp, "unknown");
+   fprintf (fp, "\n");
+}
@@ -0,0 +1,76 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "alloc.h"
+#include "topo.h"
+
+/* Thread pinning and memory placement of the benchmark arrays */
+
+enum pin_policy {
+   PIN_NONE,    /* left to the OS (or OMP_PROC_BIND) */
+   PIN_COMPACT, /* thread t on the t-th core, filling a package before the next */
+   PIN_SCATTER, /* round-robin over packages */
+};
+
+enum mem_policy {
+   MEM_DEFAULT,     /* serial initialisation: pages land on the node of the master thread */
+   MEM_FIRST_TOUCH, /* pages first touched with the static row partition of the kernel */
+   MEM_INTERLEAVE,  /* pages interleaved over all nodes with memory (mbind) */
+   MEM_BIND,        /* pages bound to one node (mbind) */
+};
+
+struct placement {
+   enum pin_policy pin;
+   int smt;           /* also pin on SMT siblings */
+   enum mem_policy mem;
+   unsigned node;     /* MEM_BIND target */
+   enum alloc_mode alloc; /* probed by placement_init */
+   unsigned nb_cpus;  /* pinning order */
+   unsigned cpus [TOPO_MAX_CPUS];
+   unsigned nb_nodes; /* nodes with memory */
+   unsigned nodes [TOPO_MAX_CPUS];
+};
+
+/* "none", "compact" or "scatter". Returns -1 if invalid */
+int placement_parse_pin (const char *str, struct placement *pl);
+
+/* "default", "firsttouch", "interleave" or "bind:<node>". Returns -1 if invalid */
+int placement_parse_mem (const char *str, struct placement *pl);
+
+/* Pinning order from the topology, allocation mode downgraded to what the
+   host supports. Returns -1 (reported on stderr) if the memory policy cannot
+   be honoured */
+int placement_init (struct placement *pl);
+
+/* Pins each thread of the OpenMP team on its CPU (no-op for PIN_NONE) */
+void placement_pin_threads (const struct placement *pl);
+
+/* Allocation in the placement allocation mode honouring the memory policy:
+   at least page-aligned and mbind-ed for interleave/bind, first-touched with
+   the static row partition for firsttouch (rows of row_bytes). pl may be NULL
+   (plain malloc) */
+void *placement_alloc (const struct placement *pl, size_t nb_rows, size_t row_bytes);
+
+/* placement_alloc, reporting the failure on stderr and exiting: for the
+   benchmark arrays, without which no measure can be made */
+void *placement_alloc_or_exit (const struct placement *pl, size_t nb_rows, size_t row_bytes);
+
+/* Whether the arrays can be initialised by all threads without moving their
+   pages: always but for MEM_DEFAULT on a host with several memory nodes. pl
+   may be NULL (MEM_DEFAULT) */
+int placement_parallel_init (const struct placement *pl);
+
+/* Releases a placement_alloc allocation of the same geometry */
+void placement_free (const struct placement *pl, void *p, size_t nb_rows, size_t row_bytes);
+
+/* Pinning and memory policy in a few words ("compact (with SMT), memory
+   bind:1"), for the record fingerprint */
+void placement_fingerprint (const struct placement *pl, char *buf, size_t len);
+
+/* One line describing the placement, recorded next to the results */
+void placement_describe (const struct placement *pl, FILE *fp);
+
+#endif
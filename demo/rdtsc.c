@@ -1,15 +1,58 @@
 #include <stdint.h>
 
+#include "rdtsc.h"
+
 #ifdef __i386
 uint64_t rdtsc() {
    uint64_t x;
    __asm__ volatile ("rdtsc" : "=A" (x));
    return x;
 }
+
+uint64_t rdtscp() {
+   uint64_t x;
+   __asm__ volatile ("rdtscp" : "=A" (x) :: "ecx");
+   return x;
+}
 #elif defined __amd64
 uint64_t rdtsc() {
    uint64_t a, d;
    __asm__ volatile ("rdtsc" : "=a" (a), "=d" (d));
    return (d<<32) | a;
 }
+
+/* Waits for previous instructions to complete before reading the TSC */
+uint64_t rdtscp() {
+   uint64_t a, d;
+   __asm__ volatile ("rdtscp" : "=a" (a), "=d" (d) :: "rcx");
+   return (d<<32) | a;
+}
+#elif defined __aarch64__
+/* Generic timer virtual count: constant rate, see CNTFRQ_EL0 */
+uint64_t rdtsc() {
+   uint64_t x;
+   __asm__ volatile ("isb; mrs %0, cntvct_el0" : "=r" (x));
+   return x;
+}
+
+uint64_t rdtscp() {
+   return rdtsc();
+}
+#endif
+
+/* Serialized reads bracketing a measured region: no instruction of the region
+   can be executed before start or after stop */
+uint64_t rdtsc_start() {
+#if defined __i386 || defined __amd64
+   __asm__ volatile ("lfence" ::: "memory");
 #endif
+   return rdtsc();
+}
+
+uint64_t rdtsc_stop() {
+   const uint64_t x = rdtscp();
+#if defined __i386 || defined __amd64
+   __asm__ volatile ("lfence" ::: "memory");
+#endif
+   return x;
+}
@@ -0,0 +1,12 @@
+#ifndef RDTSC_H
+#define RDTSC_H
+
+#include <stdint.h>
+
+/* Time-stamp counter (x86) or generic timer counter (aarch64) */
+extern uint64_t rdtsc ();
+extern uint64_t rdtscp ();
+extern uint64_t rdtsc_start ();
+extern uint64_t rdtsc_stop ();
+
+#endif
@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // strcmp, strstr, strlen
+
+#include "record.h"
+
+static int is_csv (const char *path) {
+   const size_t len = strlen (path);
+
+   return len >= 4 && strcmp (path + len - 4, ".csv") == 0;
+}
+
+/* Environment strings by key, shared by both formats */
+static char *env_field (struct env_info *env, const char *key) {
+   if (strcmp (key, "cpu") == 0) return env->cpu;
+   if (strcmp (key, "governor") == 0) return env->governor;
+   if (strcmp (key, "compiler") == 0) return env->compiler;
+   if (strcmp (key, "cflags") == 0) return env->cflags;
+   if (strcmp (key, "optflags") == 0) return env->optflags;
+   if (strcmp (key, "kernel") == 0) return env->kernel;
+   if (strcmp (key, "alloc") == 0) return env->alloc;
+   if (strcmp (key, "placement") == 0) return env->placement;
+   if (strcmp (key, "isa") == 0) return env->isa;
+   return NULL;
+}
+
+static const char *env_keys[] = { "cpu", "governor", "compiler", "cflags", "optflags", "kernel",
+                                  "alloc", "placement", "isa" };
+
+static void json_string (FILE *fp, const char *s) {
+   fputc ('"', fp);
+   for (; *s != '\0'; s++) {
+      if (*s == '"' || *s == '\\') fputc ('\\', fp);
+      if ((unsigned char) *s >= 0x20) fputc (*s, fp);
+   }
+   fputc ('"', fp);
+}
+
+static void write_json (FILE *fp, const struct env_info *env, const struct variant_result res[],
+                        const struct variant_result cold[], unsigned nb, const struct protocol *proto) {
+   const unsigned nb_sets = cold != NULL ? 2 * nb : nb;
+   unsigned i, k, m;
+
+   fprintf (fp, "{\n  \"environment\": {\n");
+   for (i=0; i<sizeof env_keys / sizeof env_keys[0]; i++) {
+      fprintf (fp, "    \"%s\": ", env_keys[i]);
+      json_string (fp, env_field ((struct env_info *) env, env_keys[i]));
+      fprintf (fp, ",\n");
+   }
+   fprintf (fp, "    \"threads\": %u\n  },\n", env->threads);
+   fprintf (fp, "  \"timer\": ");
+   json_string (fp, proto->timer->name);
+   fprintf (fp, ",\n  \"results\": [\n");
+
+   /* warm sets, then the cold ones */
+   for (k=0; k<nb_sets; k++) {
+      const struct variant_result *r = k < nb ? &res[k] : &cold[k - nb];
+      fprintf (fp, "    {\n      \"variant\": ");
+      json_string (fp, r->kv->name);
+      fprintf (fp, ",\n      \"size\": %u,\n      \"repw\": %u,\n      \"repm\": %u,\n"
+               "      \"evicted\": %d,\n      \"samples\": [", proto->size, proto->repw, proto->repm, k >= nb);
+      for (m=0; m<r->nb_metas; m++)
+         fprintf (fp, "%s%.9e", m > 0 ? ", " : "", timer_seconds (proto->timer, r->tdiff[m]) / proto->repm);
+      fprintf (fp, "]\n    }%s\n", k + 1 < nb_sets ? "," : "");
+   }
+   fprintf (fp, "  ]\n}\n");
+}
+
+static void write_csv (FILE *fp, const struct env_info *env, const struct variant_result res[],
+                       const struct variant_result cold[], unsigned nb, const struct protocol *proto) {
+   const unsigned nb_sets = cold != NULL ? 2 * nb : nb;
+   unsigned k, m;
+
+   env_print (env, "# ", fp);
+   fprintf (fp, "# timer: %s\n", proto->timer->name);
+   fprintf (fp, "variant,size,repw,repm,evicted,meta,seconds_per_call\n");
+   for (k=0; k<nb_sets; k++) {
+      const struct variant_result *r = k < nb ? &res[k] : &cold[k - nb];
+      for (m=0; m<r->nb_metas; m++)
+         fprintf (fp, "%s,%u,%u,%u,%d,%u,%.9e\n", r->kv->name, proto->size, proto->repw, proto->repm, k >= nb,
+                  m, timer_seconds (proto->timer, r->tdiff[m]) / proto->repm);
+   }
+}
+
+int record_write (const char *path, const struct env_info *env, const struct variant_result res[],
+                  const struct variant_result cold[], unsigned nb, const struct protocol *proto) {
+   FILE *fp = fopen (path, "w");
+   if (fp == NULL) {
+      fprintf (stderr, "Cannot write to %s\n", path);
+      return -1;
+   }
+
+   if (is_csv (path))
+      write_csv (fp, env, res, cold, nb, proto);
+   else
+      write_json (fp, env, res, cold, nb, proto);
+
+   if (fclose (fp) != 0) {
+      fprintf (stderr, "Cannot write to %s\n", path);
+      return -1;
+   }
+
+   return 0;
+}
+
+/* Set of (variant, size, cache state), added if absent. NULL if the record is full */
+static struct record_set *get_set (struct record *rec, const char *variant, unsigned size, int evicted) {
+   struct record_set *s = (struct record_set *) record_find (rec, variant, size, evicted);
+
+   if (s != NULL || rec->nb_sets == RECORD_MAX_SETS) return s;
+   s = &rec->sets [rec->nb_sets++];
+   snprintf (s->variant, sizeof s->variant, "%s", variant);
+   s->size = size;
+   s->evicted = evicted;
+   s->nb_samples = 0;
+   s->samples = NULL;
+
+   return s;
+}
+
+static void add_sample (struct record_set *s, double x) {
+   s->samples = realloc (s->samples, (s->nb_samples + 1) * sizeof s->samples[0]);
+   s->samples [s->nb_samples++] = x;
+}
+
+static char *read_file (const char *path) {
+   FILE *fp = fopen (path, "r");
+   if (fp == NULL) return NULL;
+
+   fseek (fp, 0, SEEK_END);
+   const long len = ftell (fp);
+   rewind (fp);
+   char *text = malloc (len + 1);
+   const size_t nb = fread (text, 1, len, fp);
+   text[nb] = '\0';
+   fclose (fp);
+
+   return text;
+}
+
+/* Position after "key": in text, NULL if absent */
+static const char *json_value (const char *text, const char *key) {
+   char pattern [RECORD_NAME_LEN + 2];
+
+   snprintf (pattern, sizeof pattern, "\"%s\"", key);
+   const char *p = strstr (text, pattern);
+   if (p == NULL) return NULL;
+   p += strlen (pattern);
+   p += strspn (p, " \t\r\n");
+
+   return *p == ':' ? p + 1 : NULL;
+}
+
+/* String value starting at p (after blanks). Returns the position after it */
+static const char *json_parse_string (const char *p, char *buf, size_t len) {
+   size_t i = 0;
+
+   p += strspn (p, " \t\r\n");
+   if (*p != '"') return NULL;
+   for (p++; *p != '\0' && *p != '"'; p++) {
+      if (*p == '\\' && p[1] != '\0') p++;
+      if (i + 1 < len) buf[i++] = *p;
+   }
+   buf[i] = '\0';
+
+   return *p == '"' ? p + 1 : NULL;
+}
+
+/* Relies on the key order of write_json within each result */
+static int read_json (const char *text, struct record *rec) {
+   char variant [RECORD_NAME_LEN];
+   unsigned i;
+
+   for (i=0; i<sizeof env_keys / sizeof env_keys[0]; i++) {
+      const char *p = json_value (text, env_keys[i]);
+      if (p != NULL) json_parse_string (p, env_field (&rec->env, env_keys[i]), ENV_STR_LEN);
+   }
+   const char *p = json_value (text, "threads");
+   if (p != NULL) rec->env.threads = strtoul (p, NULL, 10);
+
+   p = strstr (text, "\"results\"");
+   while (p != NULL && (p = json_value (p, "variant")) != NULL) {
+      if ((p = json_parse_string (p, variant, sizeof variant)) == NULL) return -1;
+      const char *q = json_value (p, "size");
+      if (q == NULL) return -1;
+      const unsigned size = strtoul (q, NULL, 10);
+
+      /* evicted is absent from older records: only looked for before samples */
+      const char *samples = json_value (p, "samples");
+      if (samples == NULL) return -1;
+      const char *e = json_value (p, "evicted");
+      const int evicted = e != NULL && e < samples ? (int) strtol (e, NULL, 10) : 0;
+      struct record_set *s = get_set (rec, variant, size, evicted);
+      if (s == NULL) return -1;
+
+      p = samples;
+      p += strspn (p, " \t\r\n");
+      if (*p != '[') return -1;
+      for (p++;;) {
+         char *end;
+         p += strspn (p, " \t\r\n,");
+         if (*p == ']') break;
+         const double x = strtod (p, &end);
+         if (end == p) return -1;
+         add_sample (s, x);
+         p = end;
+      }
+   }
+
+   return 0;
+}
+
+static int read_csv (char *text, struct record *rec) {
+   char *line, *save;
+
+   for (line = strtok_r (text, "\n", &save); line != NULL; line = strtok_r (NULL, "\n", &save)) {
+      char key [32], variant [RECORD_NAME_LEN];
+      unsigned size, repw, repm, meta;
+      int evicted = 0;
+      double x;
+      int pos;
+
+      if (line[0] == '#') {
+         if (sscanf (line, "# %31[^:]: %n", key, &pos) != 1) continue;
+         char *field = env_field (&rec->env, key);
+         if (field != NULL)
+            snprintf (field, ENV_STR_LEN, "%s", line + pos);
+         else if (strcmp (key, "threads") == 0)
+            rec->env.threads = strtoul (line + pos, NULL, 10);
+         continue;
+      }
+      /* older records have no evicted column */
+      if (sscanf (line, "%63[^,],%u,%u,%u,%d,%u,%lf", variant, &size, &repw, &repm, &evicted, &meta, &x) != 7) {
+         evicted = 0;
+         if (sscanf (line, "%63[^,],%u,%u,%u,%u,%lf", variant, &size, &repw, &repm, &meta, &x) != 6)
+            continue; /* header */
+      }
+      struct record_set *s = get_set (rec, variant, size, evicted);
+      if (s == NULL) return -1;
+      add_sample (s, x);
+   }
+
+   return 0;
+}
+
+int record_read (const char *path, struct record *rec) {
+   unsigned i;
+
+   /* fields missing from older records */
+   memset (rec, 0, sizeof *rec);
+   for (i=0; i<sizeof env_keys / sizeof env_keys[0]; i++)
+      snprintf (env_field (&rec->env, env_keys[i]), ENV_STR_LEN, "unknown");
+
+   char *text = read_file (path);
+   if (text == NULL) {
+      fprintf (stderr, "Cannot read %s\n", path);
+      return -1;
+   }
+
+   const int err = is_csv (path) ? read_csv (text, rec) : read_json (text, rec);
+   free (text);
+   if (err != 0 || rec->nb_sets == 0) {
+      fprintf (stderr, "%s: not a result record of ./measure -o\n", path);
+      record_free (rec);
+      return -1;
+   }
+
+   return 0;
+}
+
+const struct record_set *record_find (const struct record *rec, const char *variant, unsigned size,
+                                      int evicted) {
+   unsigned i;
+
+   for (i=0; i<rec->nb_sets; i++)
+      if (rec->sets[i].size == size && rec->sets[i].evicted == evicted && strcmp (rec->sets[i].variant, variant) == 0)
+         return &rec->sets[i];
+
+   return NULL;
+}
+
+void record_free (struct record *rec) {
+   unsigned i;
+
+   for (i=0; i<rec->nb_sets; i++)
+      free (rec->sets[i].samples);
+   rec->nb_sets = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include "bench.h"
+#include "env.h"
+
+/* Result records written by ./measure -o and compared by ./compare: the
+   environment fingerprint and, per variant and cache state (warm, or evicted
+   before each call with -C), every meta-repetition sample in seconds per call.
+   JSON:
+     { "environment": { "cpu": "...", ..., "threads": <n> },
+       "timer": "...",
+       "results": [ { "variant": "...", "size": <n>, "repw": <n>, "repm": <n>,
+                      "evicted": <0|1>, "samples": [ <s>, ... ] }, ... ] }
+   CSV (path ending in .csv): "# <key>: <value>" environment lines, then
+   "variant,size,repw,repm,evicted,meta,seconds_per_call" rows. Records
+   without the evicted field are read as warm */
+
+#define RECORD_MAX_SETS 256
+#define RECORD_NAME_LEN 64
+
+struct record_set {
+   char variant [RECORD_NAME_LEN];
+   unsigned size;
+   int evicted;     /* cold caches */
+   unsigned nb_samples;
+   double *samples; /* seconds per call, in run order */
+};
+
+struct record {
+   struct env_info env;
+   unsigned nb_sets;
+   struct record_set sets [RECORD_MAX_SETS];
+};
+
+/* JSON, or CSV if path ends in .csv: the warm results res and, unless NULL,
+   the cold results (same variants and protocol, evicted). Returns -1 on I/O error */
+int record_write (const char *path, const struct env_info *env, const struct variant_result res[],
+                  const struct variant_result cold[], unsigned nb, const struct protocol *proto);
+
+/* Reads a record written by record_write. Returns -1 (reported on stderr)
+   if the file cannot be read or holds no result */
+int record_read (const char *path, struct record *rec);
+
+/* Set of (variant, size, cache state), NULL if absent */
+const struct record_set *record_find (const struct record *rec, const char *variant, unsigned size,
+                                      int evicted);
+
+void record_free (struct record *rec);
+
+#endif
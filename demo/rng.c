@@ -0,0 +1,67 @@
+#include "rng.h"
+
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U /* key schedule (golden ratio, sqrt(3)-1) */
+#define PHILOX_W1 0xBB67AE85U
+#define PHILOX_ROUNDS 10
+
+#define RNG_LANES 16 /* blocks generated side by side, one per SIMD lane */
+
+/* 24 high bits: every float of [0, 1) on a 2^-24 grid */
+static inline float to_unit (uint32_t v) {
+   return (v >> 8) * 0x1p-24f;
+}
+
+/* Philox4x32-10 of the 128-bit counters (block+l, stream), 4 outputs each:
+   the 4*RNG_LANES floats of blocks block to block+RNG_LANES-1 */
+static void philox (uint64_t block, uint64_t stream, uint64_t seed, float x [4 * RNG_LANES]) {
+   uint32_t c0 [RNG_LANES], c1 [RNG_LANES], c2 [RNG_LANES], c3 [RNG_LANES];
+   uint32_t k0 = (uint32_t) seed, k1 = (uint32_t) (seed >> 32);
+   unsigned l, r;
+
+   for (l=0; l<RNG_LANES; l++) {
+      c0[l] = (uint32_t) (block + l);
+      c1[l] = (uint32_t) ((block + l) >> 32);
+      c2[l] = (uint32_t) stream;
+      c3[l] = (uint32_t) (stream >> 32);
+   }
+
+   for (r=0; r<PHILOX_ROUNDS; r++) {
+      for (l=0; l<RNG_LANES; l++) {
+         const uint64_t p0 = (uint64_t) PHILOX_M0 * c0[l];
+         const uint64_t p1 = (uint64_t) PHILOX_M1 * c2[l];
+         c0[l] = (uint32_t) (p1 >> 32) ^ c1[l] ^ k0;
+         c1[l] = (uint32_t) p1;
+         c2[l] = (uint32_t) (p0 >> 32) ^ c3[l] ^ k1;
+         c3[l] = (uint32_t) p0;
+      }
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+   }
+
+   for (l=0; l<RNG_LANES; l++) {
+      x[4*l]   = to_unit (c0[l]);
+      x[4*l+1] = to_unit (c1[l]);
+      x[4*l+2] = to_unit (c2[l]);
+      x[4*l+3] = to_unit (c3[l]);
+   }
+}
+
+void rng_fill (size_t n, float x[], uint64_t seed, uint64_t stream, int parallel) {
+   const size_t chunk = 4 * RNG_LANES;
+   const size_t nb_chunks = n / chunk;
+   size_t k;
+
+   #pragma omp parallel for schedule(static) if(parallel)
+   for (k=0; k<nb_chunks; k++)
+      philox (k * RNG_LANES, stream, seed, x + k * chunk);
+
+   /* last partial chunk */
+   if (n % chunk != 0) {
+      float last [4 * RNG_LANES];
+      philox (nb_chunks * RNG_LANES, stream, seed, last);
+      for (k=nb_chunks*chunk; k<n; k++)
+         x[k] = last [k - nb_chunks*chunk];
+   }
+}
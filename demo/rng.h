@@ -0,0 +1,20 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Counter-based random initialisation of the benchmark arrays (Philox4x32-10,
+   Salmon et al., SC'11): element i of a stream is a pure function of (seed,
+   stream, i), so arrays are filled in parallel and SIMD with the same values
+   whatever the thread count, on every machine. Each array of a problem takes
+   its own stream */
+
+#define RNG_SEED 0 /* replaces srand(0) */
+
+/* Fills x[0..n-1] with uniform floats in [0, 1) of the given stream. Static
+   partition over the OpenMP threads unless parallel is 0 (pages first touched
+   by the calling thread) */
+void rng_fill (size_t n, float x[], uint64_t seed, uint64_t stream, int parallel);
+
+#endif
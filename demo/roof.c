@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h> // strcmp, strlen
+#include <time.h>   // clock_gettime
+#include <omp.h>
+
+#include "kernels.h"
+#include "roof.h"
+
+#define LINE_MAX_LEN 4096
+#define PEAK_MIN_SECONDS 0.05 /* per trial */
+
+/* roof_kernels.c compiled once per ISA, see Makefile */
+#define ROOF_DECLARE(s) \
+   extern void roof_copy_##s (size_t n, float *restrict dst, const float *restrict src); \
+   extern void roof_triad_##s (size_t n, float *restrict a, const float *restrict b, \
+                               const float *restrict c, float scalar); \
+   extern double roof_peak_##s (uint64_t nb_iters);
+
+ROOF_DECLARE(sse2)
+ROOF_DECLARE(avx2)
+ROOF_DECLARE(avx512)
+
+struct roof_kernels {
+   const char *isa;
+   void (*copy) (size_t n, float *restrict dst, const float *restrict src);
+   void (*triad) (size_t n, float *restrict a, const float *restrict b, const float *restrict c, float s);
+   double (*peak) (uint64_t nb_iters);
+};
+
+/* Widest first */
+static const struct roof_kernels builds[] = {
+   { "avx512", roof_copy_avx512, roof_triad_avx512, roof_peak_avx512 },
+   { "avx2",   roof_copy_avx2,   roof_triad_avx2,   roof_peak_avx2 },
+   { "sse2",   roof_copy_sse2,   roof_triad_sse2,   roof_peak_sse2 },
+};
+
+static double wall_seconds (void) {
+   struct timespec ts;
+   clock_gettime (CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Best GB/s over ROOF_NB_TRIALS, each thread streaming over its own arrays
+   of thread_bytes in total. Returns -1 on allocation failure */
+static double bandwidth (const struct roof_kernels *k, int triad, uint64_t thread_bytes) {
+   const unsigned nb_arrays = triad ? 3 : 2;
+   size_t n = thread_bytes / (nb_arrays * sizeof (float)) / 16 * 16;
+   if (n < 16) n = 16;
+   const uint64_t thread_pass = (uint64_t) n * nb_arrays * sizeof (float);
+   uint64_t reps = ROOF_TRIAL_BYTES / (thread_pass * omp_get_max_threads());
+   if (reps == 0) reps = 1;
+   double best = 0.0, t0 = 0.0;
+   unsigned nb_threads = 1;
+   int failed = 0;
+
+   #pragma omp parallel
+   {
+      float *x = malloc (n * sizeof x[0]);
+      float *y = malloc (n * sizeof y[0]);
+      float *z = malloc (n * sizeof z[0]);
+      const int ok = x != NULL && y != NULL && z != NULL;
+      uint64_t r;
+      unsigned t;
+      size_t i;
+
+      if (!ok) {
+         #pragma omp atomic write
+         failed = 1;
+      } else {
+         /* first touch by the streaming thread */
+         for (i=0; i<n; i++) {
+            x[i] = 1.0f;
+            y[i] = 2.0f;
+            z[i] = 0.0f;
+         }
+      }
+
+      #pragma omp master
+      nb_threads = omp_get_num_threads();
+
+      for (t=0; t<ROOF_NB_TRIALS; t++) {
+         #pragma omp barrier
+         #pragma omp master
+         t0 = wall_seconds();
+
+         if (ok) {
+            for (r=0; r<reps; r++) {
+               if (triad) k->triad (n, z, x, y, 3.0f);
+               else k->copy (n, z, x);
+            }
+         }
+
+         #pragma omp barrier
+         #pragma omp master
+         {
+            const double s = wall_seconds() - t0;
+            if (best == 0.0 || s < best) best = s;
+         }
+      }
+
+      free (x);
+      free (y);
+      free (z);
+   }
+
+   if (failed) return -1.0;
+   return best > 0 ? thread_pass * nb_threads * reps / best * 1e-9 : 0.0;
+}
+
+/* Best GFLOP/s over ROOF_NB_TRIALS on one thread or on all of them */
+static double peak (const struct roof_kernels *k, int all_threads) {
+   uint64_t nb_iters = 1 << 16;
+   double best = 0.0;
+   unsigned t;
+
+   /* trials of at least PEAK_MIN_SECONDS */
+   for (;;) {
+      const double t0 = wall_seconds();
+      k->peak (nb_iters);
+      if (wall_seconds() - t0 >= PEAK_MIN_SECONDS) break;
+      nb_iters *= 2;
+   }
+
+   for (t=0; t<ROOF_NB_TRIALS; t++) {
+      double flops = 0.0;
+      const double t0 = wall_seconds();
+      if (all_threads) {
+         #pragma omp parallel reduction(+:flops)
+         flops += k->peak (nb_iters);
+      } else {
+         flops = k->peak (nb_iters);
+      }
+      const double gflops = flops / (wall_seconds() - t0) * 1e-9;
+      if (gflops > best) best = gflops;
+   }
+
+   return best;
+}
+
+int roof_measure (struct roofline *r) {
+   struct cache_level caches [TOPO_MAX_CACHES];
+   const unsigned nb_caches = topo_caches (caches);
+   const unsigned nb_threads = omp_get_max_threads();
+   const struct roof_kernels *k = &builds [sizeof builds / sizeof builds[0] - 1];
+   unsigned i;
+
+   for (i=0; i<sizeof builds / sizeof builds[0]; i++)
+      if (kernels_isa_supported (builds[i].isa)) {
+         k = &builds[i];
+         break;
+      }
+
+   topo_cpu_model (r->cpu, sizeof r->cpu);
+   r->threads = nb_threads;
+   snprintf (r->isa, sizeof r->isa, "%s", k->isa);
+
+   fprintf (stderr, "Roofline: measuring %s peak FP throughput\n", k->isa);
+   r->peak_gflops_1t = peak (k, 0);
+   r->peak_gflops = peak (k, 1);
+
+   /* working sets of half of each level: per thread for private levels,
+      shared by all threads for the last one */
+   r->nb_levels = 0;
+   for (i=0; i<=nb_caches; i++) {
+      struct roof_level *l = &r->levels [r->nb_levels];
+      uint64_t thread_bytes;
+
+      if (i < nb_caches) {
+         snprintf (l->name, sizeof l->name, "L%u", caches[i].level);
+         l->cache_size = caches[i].size;
+         thread_bytes = caches[i].size / 2;
+         if (i == nb_caches - 1) thread_bytes /= nb_threads;
+      } else {
+         uint64_t total = nb_caches > 0 ? 4 * caches [nb_caches-1].size : 0;
+         if (total < ROOF_DRAM_MIN_BYTES) total = ROOF_DRAM_MIN_BYTES;
+         if (total > ROOF_DRAM_MAX_BYTES) total = ROOF_DRAM_MAX_BYTES;
+         snprintf (l->name, sizeof l->name, "DRAM");
+         l->cache_size = 0;
+         thread_bytes = total / nb_threads;
+      }
+
+      fprintf (stderr, "Roofline: measuring %s bandwidth (%lu bytes per thread)\n", l->name, thread_bytes);
+      l->copy_gbs = bandwidth (k, 0, thread_bytes);
+      l->triad_gbs = bandwidth (k, 1, thread_bytes);
+      if (l->copy_gbs < 0 || l->triad_gbs < 0) {
+         fprintf (stderr, "Cannot allocate the %s bandwidth arrays\n", l->name);
+         return -1;
+      }
+      r->nb_levels++;
+   }
+
+   return 0;
+}
+
+/* Parses one entry, skipping comments. Returns 0 on success */
+static int parse_line (const char *line, struct roofline *r) {
+   int pos, len;
+   unsigned i;
+
+   if (line[0] == '#') return -1;
+   if (sscanf (line, "%127s %u %15s %lf %lf %u%n", r->cpu, &r->threads, r->isa, &r->peak_gflops_1t,
+               &r->peak_gflops, &r->nb_levels, &pos) != 6 || r->nb_levels > ROOF_MAX_LEVELS)
+      return -1;
+
+   for (i=0; i<r->nb_levels; i++) {
+      struct roof_level *l = &r->levels[i];
+      if (sscanf (line + pos, "%7s %lu %lf %lf%n", l->name, &l->cache_size, &l->copy_gbs,
+                  &l->triad_gbs, &len) != 4)
+         return -1;
+      pos += len;
+   }
+
+   return 0;
+}
+
+static void print_entry (FILE *fp, const struct roofline *r) {
+   unsigned i;
+
+   fprintf (fp, "%s %u %s %.3f %.3f %u", r->cpu, r->threads, r->isa, r->peak_gflops_1t,
+            r->peak_gflops, r->nb_levels);
+   for (i=0; i<r->nb_levels; i++)
+      fprintf (fp, " %s %lu %.3f %.3f", r->levels[i].name, r->levels[i].cache_size,
+               r->levels[i].copy_gbs, r->levels[i].triad_gbs);
+   fprintf (fp, "\n");
+}
+
+int roof_cfg_read (const char *path, const char *cpu, unsigned threads, struct roofline *r) {
+   static char line [LINE_MAX_LEN];
+   static struct roofline cur;
+   int found = -1;
+
+   FILE *fp = fopen (path, "r");
+   if (fp == NULL) return -1;
+
+   /* last entry wins */
+   while (fgets (line, sizeof line, fp) != NULL) {
+      if (parse_line (line, &cur) != 0) continue;
+      if (cur.threads != threads || strcmp (cur.cpu, cpu) != 0) continue;
+      *r = cur;
+      found = 0;
+   }
+
+   fclose (fp);
+
+   return found;
+}
+
+int roof_cfg_write (const char *path, const struct roofline *r) {
+   static char line [LINE_MAX_LEN];
+   static struct roofline cur;
+
+   /* keep other entries, written to a temporary file renamed over path */
+   char *tmp_path = malloc (strlen (path) + 5);
+   sprintf (tmp_path, "%s.tmp", path);
+
+   FILE *out = fopen (tmp_path, "w");
+   if (out == NULL) {
+      fprintf (stderr, "Cannot write to %s\n", tmp_path);
+      free (tmp_path);
+      return -1;
+   }
+   fprintf (out, "# cpu threads isa peak_gflops_1t peak_gflops nb_levels [level cache_bytes copy_gbs triad_gbs]... (written by measure -R)\n");
+
+   FILE *in = fopen (path, "r");
+   if (in != NULL) {
+      while (fgets (line, sizeof line, in) != NULL) {
+         if (parse_line (line, &cur) != 0) continue;
+         if (cur.threads == r->threads && strcmp (cur.cpu, r->cpu) == 0) continue;
+         print_entry (out, &cur);
+      }
+      fclose (in);
+   }
+   print_entry (out, r);
+
+   const int err = fclose (out) != 0 || rename (tmp_path, path) != 0;
+   if (err) fprintf (stderr, "Cannot write to %s\n", path);
+   free (tmp_path);
+
+   return err ? -1 : 0;
+}
+
+const struct roof_level *roof_level_for (const struct roofline *r, uint64_t ws) {
+   const unsigned nb_caches = r->nb_levels - 1;
+   unsigned i;
+
+   for (i=0; i<nb_caches; i++) {
+      const uint64_t need = i < nb_caches - 1 ? ws / r->threads : ws;
+      if (need <= r->levels[i].cache_size) return &r->levels[i];
+   }
+
+   return &r->levels [r->nb_levels - 1];
+}
+
+double roof_attainable (const struct roofline *r, double ai, uint64_t ws,
+                        const struct roof_level **level, int *memory_bound) {
+   const struct roof_level *l = roof_level_for (r, ws);
+   const double mem = ai * (l->copy_gbs > l->triad_gbs ? l->copy_gbs : l->triad_gbs);
+
+   if (level != NULL) *level = l;
+   if (memory_bound != NULL) *memory_bound = mem < r->peak_gflops;
+
+   return mem < r->peak_gflops ? mem : r->peak_gflops;
+}
+
+void roof_describe (const struct roofline *r, FILE *fp) {
+   unsigned i;
+
+   fprintf (fp, "Roofline of %s, %u threads: %s peak %.2f GFLOP/s (1 thread %.2f GFLOP/s)\n",
+            r->cpu, r->threads, r->isa, r->peak_gflops, r->peak_gflops_1t);
+   for (i=0; i<r->nb_levels; i++)
+      fprintf (fp, "  %-5s copy %9.2f GB/s, triad %9.2f GB/s, ridge point %.3f flop/byte\n",
+               r->levels[i].name, r->levels[i].copy_gbs, r->levels[i].triad_gbs,
+               r->peak_gflops / (r->levels[i].copy_gbs > r->levels[i].triad_gbs ?
+                                 r->levels[i].copy_gbs : r->levels[i].triad_gbs));
+}
@@ -0,0 +1,62 @@
+#ifndef ROOF_H
+#define ROOF_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "topo.h"
+
+/* Machine roofline for ./measure -R: peak single- and multi-thread FP
+   throughput and STREAM-like copy/triad bandwidths with working sets held
+   by each cache level and by DRAM. Results are cached per (CPU model,
+   thread count) in a file, one line per machine:
+   "<cpu model> <threads> <isa> <peak 1t> <peak> <nb levels> [<level> <cache bytes> <copy> <triad>]..."
+   with GFLOP/s and GB/s figures */
+
+#define ROOF_CFG_DEFAULT "roof.cfg"
+#define ROOF_MAX_LEVELS (TOPO_MAX_CACHES + 1)
+#define ROOF_NB_TRIALS 5                        /* best of */
+#define ROOF_TRIAL_BYTES (256UL << 20)          /* bytes moved per bandwidth trial, at least */
+#define ROOF_DRAM_MIN_BYTES (64UL << 20)        /* DRAM working set: 4 x last level, within these bounds */
+#define ROOF_DRAM_MAX_BYTES (512UL << 20)
+
+struct roof_level {
+   char name [8];       /* L1, L2... DRAM */
+   uint64_t cache_size; /* bytes, 0 for DRAM */
+   double copy_gbs, triad_gbs;
+};
+
+struct roofline {
+   char cpu [128];
+   unsigned threads;
+   char isa [16];         /* of the peak FP kernel */
+   double peak_gflops_1t; /* single thread */
+   double peak_gflops;    /* all threads */
+   unsigned nb_levels;    /* caches, then DRAM */
+   struct roof_level levels [ROOF_MAX_LEVELS];
+};
+
+/* Measures the roofline of this host with the current OpenMP thread count
+   (progress on stderr). Returns -1 on allocation failure */
+int roof_measure (struct roofline *r);
+
+/* Returns 0 and fills r if the file has an entry for (cpu, threads), -1 otherwise */
+int roof_cfg_read (const char *path, const char *cpu, unsigned threads, struct roofline *r);
+
+/* Adds or replaces the entry of (r->cpu, r->threads). Returns -1 on I/O error */
+int roof_cfg_write (const char *path, const struct roofline *r);
+
+/* Level whose bandwidth bounds a kernel with a working set of ws bytes split
+   over the threads: private levels hold ws / threads, the last one ws */
+const struct roof_level *roof_level_for (const struct roofline *r, uint64_t ws);
+
+/* min (peak, ai x best of copy and triad bandwidths of the level of ws), in
+   GFLOP/s: copy is the closer model for read-mostly kernels. Sets
+   *memory_bound if the bandwidth is the lower roof */
+double roof_attainable (const struct roofline *r, double ai, uint64_t ws,
+                        const struct roof_level **level, int *memory_bound);
+
+/* Peaks and bandwidths table */
+void roof_describe (const struct roofline *r, FILE *fp);
+
+#endif
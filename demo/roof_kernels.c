@@ -0,0 +1,68 @@
+/* Roofline micro-kernels, compiled once per ISA (see Makefile): ROOF_SUFFIX
+   names the copy, triad and peak functions of each build */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ROOF_CAT(a,b) a##_##b
+#define ROOF_XCAT(a,b) ROOF_CAT(a,b)
+#define ROOF_NAME(f) ROOF_XCAT(roof_##f, ROOF_SUFFIX)
+
+#if defined __AVX512F__
+#define VEC_BYTES 64
+#elif defined __AVX__
+#define VEC_BYTES 32
+#else
+#define VEC_BYTES 16
+#endif
+
+/* Independent multiply-add chains: covers latency x issue width of current
+   FMA units (4 cycles x 2 ports) with some margin */
+#define NB_CHAINS 12
+
+typedef float vec __attribute__((vector_size(VEC_BYTES)));
+
+volatile float ROOF_NAME(sink);
+
+/* STREAM copy: dst[i] = src[i] */
+void ROOF_NAME(copy) (size_t n, float *restrict dst, const float *restrict src) {
+   size_t i;
+
+   #pragma omp simd
+   for (i=0; i<n; i++)
+      dst[i] = src[i];
+}
+
+/* STREAM triad: a[i] = b[i] + s * c[i] */
+void ROOF_NAME(triad) (size_t n, float *restrict a, const float *restrict b,
+                       const float *restrict c, float s) {
+   size_t i;
+
+   #pragma omp simd
+   for (i=0; i<n; i++)
+      a[i] = b[i] + s * c[i];
+}
+
+/* Runs nb_iters multiply-adds on each chain. Returns the number of flops */
+double ROOF_NAME(peak) (uint64_t nb_iters) {
+   const vec m = (vec) {} + 0.999999f;
+   const vec add = (vec) {} + 1e-6f;
+   vec acc [NB_CHAINS];
+   uint64_t it;
+   unsigned k, l;
+
+   for (k=0; k<NB_CHAINS; k++)
+      acc[k] = (vec) {} + (float) k;
+
+   for (it=0; it<nb_iters; it++)
+      for (k=0; k<NB_CHAINS; k++)
+         acc[k] = acc[k] * m + add;
+
+   float sum = 0.0f;
+   for (k=0; k<NB_CHAINS; k++)
+      for (l=0; l<VEC_BYTES / sizeof (float); l++)
+         sum += acc[k][l];
+   ROOF_NAME(sink) = sum;
+
+   return 2.0 * NB_CHAINS * (VEC_BYTES / sizeof (float)) * nb_iters;
+}
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h> // setenv, getenv, qsort
+#include <string.h> // strcmp, strtok
+#include <unistd.h> // execv
+#include <omp.h>
+
+#include "scaling.h"
+#include "topo.h"
+
+#define POLICY_ENV "MEASURE_OMP_POLICY" /* set once the policy is applied */
+
+unsigned scaling_setup_env (char *argv[], int smt) {
+   static struct cpu_info cpus [TOPO_MAX_CPUS];
+   const unsigned nb_cpus = topo_cpus (cpus);
+   unsigned i, nb_places = 0;
+
+   /* one place per core, or per hardware thread with SMT */
+   char *places = malloc (nb_cpus * 16 + 1);
+   places[0] = '\0';
+   for (i=0; i<nb_cpus; i++) {
+      if (!smt && cpus[i].smt_rank > 0) continue;
+      sprintf (places + strlen (places), "%s{%u}", nb_places > 0 ? "," : "", cpus[i].cpu);
+      nb_places++;
+   }
+
+   const char *applied = getenv (POLICY_ENV);
+   if (applied != NULL && strcmp (applied, places) == 0) {
+      free (places);
+      return nb_places;
+   }
+
+   setenv ("OMP_PROC_BIND", "close", 1);
+   setenv ("OMP_PLACES", places, 1);
+   setenv (POLICY_ENV, places, 1);
+   free (places);
+
+   /* the OpenMP runtime reads its environment when loaded */
+   execv ("/proc/self/exe", argv);
+   perror ("Cannot re-execute with the OpenMP placement policy");
+
+   return 0;
+}
+
+static int cmp_unsigned (const void *a, const void *b) {
+   const unsigned va = *((unsigned *) a);
+   const unsigned vb = *((unsigned *) b);
+
+   return (va > vb) - (va < vb);
+}
+
+unsigned scaling_parse (const char *str, unsigned max_threads, unsigned threads [SCALING_MAX_POINTS]) {
+   unsigned first, last, t, i, nb = 0;
+
+   threads [nb++] = 1;
+
+   if (strcmp (str, "all") == 0) {
+      first = 2;
+      last = max_threads;
+      for (t = first; t <= last && nb < SCALING_MAX_POINTS; t++)
+         threads [nb++] = t;
+   } else if (sscanf (str, "%u-%u", &first, &last) == 2 && strchr (str, ',') == NULL) {
+      if (first == 0 || last < first) return 0;
+      for (t = first; t <= last && t <= max_threads && nb < SCALING_MAX_POINTS; t++)
+         if (t > 1) threads [nb++] = t;
+   } else {
+      char *list = strdup (str);
+      char *tok;
+      for (tok = strtok (list, ","); tok != NULL && nb < SCALING_MAX_POINTS; tok = strtok (NULL, ",")) {
+         t = atoi (tok);
+         if (t == 0) {
+            free (list);
+            return 0;
+         }
+         if (t > max_threads)
+            fprintf (stderr, "Skipping %u threads: only %u places\n", t, max_threads);
+         else if (t > 1)
+            threads [nb++] = t;
+      }
+      free (list);
+   }
+
+   /* sorted, without duplicates */
+   qsort (threads, nb, sizeof threads[0], cmp_unsigned);
+   unsigned j = 0;
+   for (i=0; i<nb; i++)
+      if (j == 0 || threads[i] != threads[j-1])
+         threads [j++] = threads[i];
+
+   return j;
+}
+
+void scaling_run (struct variant_result res[], unsigned nb, const struct protocol *proto,
+                  const unsigned threads[], unsigned nb_threads, FILE *out) {
+   const struct timer *timer = proto->timer;
+   unsigned v, i;
+
+   double *med = malloc (nb_threads * sizeof med[0]);
+   double *ci = malloc (nb_threads * sizeof ci[0]);
+
+   for (v=0; v<nb; v++) {
+      for (i=0; i<nb_threads; i++) {
+         omp_set_num_threads (threads[i]);
+         fprintf (stderr, "[%s] %u threads\n", res[v].kv->name, threads[i]);
+         bench_run_metas (&res[v], proto);
+         med[i] = timer_seconds (timer, res[v].med);
+         ci[i] = bench_ci_width (&res[v]) * 100;
+      }
+
+      fprintf (out, "\n[%s] thread scaling, OMP_PROC_BIND=%s OMP_PLACES=%s\n", res[v].kv->name,
+               getenv ("OMP_PROC_BIND"), getenv ("OMP_PLACES"));
+      fprintf (out, "%8s %12s %8s %9s %11s %11s\n", "THREADS", "MED (s)", "CI (%)", "SPEEDUP",
+               "EFFICIENCY", "KARP-FLATT");
+      for (i=0; i<nb_threads; i++) {
+         const unsigned p = threads[i];
+         const double speedup = med[i] > 0 ? med[0] / med[i] : 0.0;
+         fprintf (out, "%8u %12.6f %8.2f %8.2fx %10.1f%%", p, med[i], ci[i], speedup,
+                  speedup * 100 / p);
+         /* experimentally determined serial fraction: (1/S - 1/p) / (1 - 1/p) */
+         if (p > 1 && speedup > 0)
+            fprintf (out, " %11.4f\n", (1.0 / speedup - 1.0 / p) / (1.0 - 1.0 / p));
+         else
+            fprintf (out, " %11s\n", "-");
+      }
+   }
+
+   omp_set_num_threads (threads [nb_threads-1]);
+   free (med);
+   free (ci);
+}
@@ -0,0 +1,26 @@
+#ifndef SCALING_H
+#define SCALING_H
+
+#include <stdio.h>
+
+#include "bench.h"
+
+/* Thread-scaling study of the measure driver: the protocol is rerun for each
+   thread count under a fixed OMP_PROC_BIND/OMP_PLACES policy */
+
+#define SCALING_MAX_POINTS 256
+
+/* Pins OpenMP threads with OMP_PROC_BIND=close and one place per core (or
+   per hardware thread if smt), then re-executes the program once so that the
+   OpenMP runtime reads them. Returns the number of places, 0 on failure */
+unsigned scaling_setup_env (char *argv[], int smt);
+
+/* "all", "<first>-<last>" or "<n>,<n>,..." capped to max_threads. 1 is always
+   measured first as the reference. Returns the number of counts, 0 if invalid */
+unsigned scaling_parse (const char *str, unsigned max_threads, unsigned threads [SCALING_MAX_POINTS]);
+
+/* Speedup, parallel efficiency and Karp-Flatt serial fraction per thread count */
+void scaling_run (struct variant_result res[], unsigned nb, const struct protocol *proto,
+                  const unsigned threads[], unsigned nb_threads, FILE *out);
+
+#endif
@@ -0,0 +1,251 @@
+#include <stdlib.h> // qsort, malloc
+#include <string.h> // memcpy
+#include <math.h>   // fabs, sqrt, log, erfc
+
+#include "stats.h"
+
+static int cmp_double (const void *a, const void *b) {
+   const double va = *((double *) a);
+   const double vb = *((double *) b);
+
+   if (va < vb) return -1;
+   if (va > vb) return 1;
+   return 0;
+}
+
+static double median_sorted (const double *x, unsigned n) {
+   return n % 2 ? x[n/2] : (x[n/2 - 1] + x[n/2]) / 2;
+}
+
+/* sorts in place */
+static double median_inplace (double *x, unsigned n) {
+   qsort (x, n, sizeof x[0], cmp_double);
+   return median_sorted (x, n);
+}
+
+double stats_median (const double *x, unsigned n) {
+   if (n == 0) return 0.0;
+
+   double *tmp = malloc (n * sizeof tmp[0]);
+   memcpy (tmp, x, n * sizeof tmp[0]);
+   const double med = median_inplace (tmp, n);
+   free (tmp);
+
+   return med;
+}
+
+double stats_mad (const double *x, unsigned n) {
+   unsigned i;
+
+   if (n == 0) return 0.0;
+
+   const double med = stats_median (x, n);
+   double *dev = malloc (n * sizeof dev[0]);
+   for (i=0; i<n; i++)
+      dev[i] = fabs (x[i] - med);
+   const double mad = median_inplace (dev, n);
+   free (dev);
+
+   return 1.4826 * mad;
+}
+
+unsigned stats_mad_outliers (const double *x, unsigned n, double k, int *flags) {
+   unsigned i, nb = 0;
+
+   const double med = stats_median (x, n);
+   const double mad = stats_mad (x, n);
+
+   for (i=0; i<n; i++) {
+      /* all samples equal but this one: any deviation is an outlier */
+      const int out = mad > 0 ? fabs (x[i] - med) > k * mad : x[i] != med;
+      if (flags != NULL) flags[i] = out;
+      nb += out;
+   }
+
+   return nb;
+}
+
+/* xorshift64*: fast and good enough to draw resample indices */
+static uint64_t next_rand (uint64_t *state) {
+   uint64_t x = *state;
+   x ^= x >> 12;
+   x ^= x << 25;
+   x ^= x >> 27;
+   *state = x;
+   return x * 0x2545F4914F6CDD1DULL;
+}
+
+void stats_bootstrap_median_ci (const double *x, unsigned n, unsigned nb_resamples,
+                                double level, double *lo, double *hi) {
+   unsigned r, i;
+
+   if (n < 2) {
+      *lo = *hi = n == 1 ? x[0] : 0.0;
+      return;
+   }
+
+   double *sample = malloc (n * sizeof sample[0]);
+   double *medians = malloc (nb_resamples * sizeof medians[0]);
+   uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+   for (r=0; r<nb_resamples; r++) {
+      for (i=0; i<n; i++)
+         sample[i] = x [next_rand (&state) % n];
+      medians[r] = median_inplace (sample, n);
+   }
+   qsort (medians, nb_resamples, sizeof medians[0], cmp_double);
+
+   const double alpha = (1.0 - level) / 2;
+   unsigned ilo = (unsigned) (alpha * nb_resamples);
+   unsigned ihi = (unsigned) ((1.0 - alpha) * nb_resamples);
+   if (ihi >= nb_resamples) ihi = nb_resamples - 1;
+   *lo = medians[ilo];
+   *hi = medians[ihi];
+
+   free (sample);
+   free (medians);
+}
+
+/* Sum of squared deviations to the mean on [lo,hi) from prefix sums */
+static double sse (const double *s1, const double *s2, unsigned lo, unsigned hi) {
+   const double n = hi - lo;
+   const double sum = s1[hi] - s1[lo];
+
+   return (s2[hi] - s2[lo]) - sum * sum / n;
+}
+
+#define MIN_SEGMENT 2
+
+static void split (const double *s1, const double *s2, unsigned lo, unsigned hi, double penalty,
+                   unsigned *cp, unsigned *nb_cp, unsigned max_cp) {
+   unsigned k, best_k = 0;
+   double best_gain = 0.0;
+
+   if (hi - lo < 2 * MIN_SEGMENT || *nb_cp == max_cp) return;
+
+   const double total = sse (s1, s2, lo, hi);
+   for (k = lo + MIN_SEGMENT; k + MIN_SEGMENT <= hi; k++) {
+      const double gain = total - sse (s1, s2, lo, k) - sse (s1, s2, k, hi);
+      if (gain > best_gain) {
+         best_gain = gain;
+         best_k = k;
+      }
+   }
+   if (best_k == 0 || best_gain <= penalty) return;
+
+   cp [(*nb_cp)++] = best_k;
+   split (s1, s2, lo, best_k, penalty, cp, nb_cp, max_cp);
+   split (s1, s2, best_k, hi, penalty, cp, nb_cp, max_cp);
+}
+
+static int cmp_unsigned (const void *a, const void *b) {
+   const unsigned va = *((unsigned *) a);
+   const unsigned vb = *((unsigned *) b);
+
+   return (va > vb) - (va < vb);
+}
+
+unsigned stats_change_points (const double *x, unsigned n, unsigned *cp, unsigned max_cp) {
+   unsigned i, nb_cp = 0;
+
+   if (n < 2 * MIN_SEGMENT) return 0;
+
+   double *s1 = malloc ((n+1) * sizeof s1[0]);
+   double *s2 = malloc ((n+1) * sizeof s2[0]);
+   s1[0] = s2[0] = 0.0;
+   for (i=0; i<n; i++) {
+      s1[i+1] = s1[i] + x[i];
+      s2[i+1] = s2[i] + x[i] * x[i];
+   }
+
+   /* noise level from first differences: insensitive to level shifts */
+   double *diff = malloc ((n-1) * sizeof diff[0]);
+   for (i=0; i<n-1; i++)
+      diff[i] = x[i+1] - x[i];
+   const double sigma = stats_mad (diff, n-1) / sqrt (2.0);
+   free (diff);
+
+   split (s1, s2, 0, n, 2.0 * sigma * sigma * log (n), cp, &nb_cp, max_cp);
+   qsort (cp, nb_cp, sizeof cp[0], cmp_unsigned);
+
+   free (s1);
+   free (s2);
+
+   return nb_cp;
+}
+
+#define MAX_CHANGE_POINTS 32
+
+unsigned stats_steady_state_start (const double *x, unsigned n) {
+   unsigned cp [MAX_CHANGE_POINTS];
+   unsigned i, start = 0;
+
+   const unsigned nb_cp = stats_change_points (x, n, cp, MAX_CHANGE_POINTS);
+
+   /* a drop in the last tenth of the series is too short to be a steady state */
+   const unsigned min_steady = n / 10 > 2 * MIN_SEGMENT ? n / 10 : 2 * MIN_SEGMENT;
+
+   for (i=0; i<nb_cp; i++) {
+      if (n - cp[i] < min_steady) break;
+      const unsigned lo = i > 0 ? cp[i-1] : 0;
+      const unsigned hi = i+1 < nb_cp ? cp[i+1] : n;
+      const double before = stats_median (x + lo, cp[i] - lo);
+      const double after = stats_median (x + cp[i], hi - cp[i]);
+      if (after < before) start = cp[i];
+   }
+
+   return start;
+}
+
+struct ranked {
+   double v;
+   int from_y;
+};
+
+static int cmp_ranked (const void *a, const void *b) {
+   return cmp_double (&((const struct ranked *) a)->v, &((const struct ranked *) b)->v);
+}
+
+double stats_mann_whitney (const double *x, unsigned nx, const double *y, unsigned ny) {
+   const unsigned n = nx + ny;
+   struct ranked *all = malloc (n * sizeof all[0]);
+   double rank_y = 0.0, ties = 0.0;
+   unsigned i, j;
+
+   if (nx == 0 || ny == 0) {
+      free (all);
+      return 1.0;
+   }
+
+   for (i=0; i<nx; i++) all[i] = (struct ranked) { x[i], 0 };
+   for (i=0; i<ny; i++) all[nx+i] = (struct ranked) { y[i], 1 };
+   qsort (all, n, sizeof all[0], cmp_ranked);
+
+   /* average ranks (from 1) over runs of ties */
+   for (i=0; i<n; i=j) {
+      for (j=i+1; j<n && all[j].v == all[i].v; j++);
+      const double t = j - i;
+      const double rank = (i + 1 + j) / 2.0;
+      unsigned k;
+      for (k=i; k<j; k++)
+         if (all[k].from_y) rank_y += rank;
+      ties += t * t * t - t;
+   }
+   free (all);
+
+   const double u = rank_y - ny * (ny + 1) / 2.0;
+   const double mean = nx * (double) ny / 2;
+   const double var = nx * (double) ny / 12 * ((n + 1) - ties / ((double) n * (n - 1)));
+   if (var <= 0) return 1.0;
+
+   /* continuity correction */
+   const double z = (u - mean - 0.5) / sqrt (var);
+   return 0.5 * erfc (z / sqrt (2.0));
+}
+
+void stats_from_uint64 (const uint64_t *in, unsigned n, double *out) {
+   unsigned i;
+
+   for (i=0; i<n; i++)
+      out[i] = (double) in[i];
+}
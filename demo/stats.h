@@ -0,0 +1,45 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+
+/* Robust statistics on meta-repetition samples */
+
+/* Median of n values (x is left unchanged) */
+double stats_median (const double *x, unsigned n);
+
+/* Median absolute deviation around the median, scaled by 1.4826 to estimate
+   the standard deviation of normally distributed samples */
+double stats_mad (const double *x, unsigned n);
+
+/* Flags samples farther than k scaled MADs from the median (flags may be NULL).
+   Returns the number of outliers */
+unsigned stats_mad_outliers (const double *x, unsigned n, double k, int *flags);
+
+/* Percentile bootstrap confidence interval of the median at the given level
+   (e.g. 0.95). Deterministic: resamples are drawn from a fixed seed */
+void stats_bootstrap_median_ci (const double *x, unsigned n, unsigned nb_resamples,
+                                double level, double *lo, double *hi);
+
+/* Change points of the mean of a series by binary segmentation, with a BIC
+   penalty on a robust noise estimate. Stores at most max_cp sorted indices
+   (first index of each new segment) in cp, returns their number */
+unsigned stats_change_points (const double *x, unsigned n, unsigned *cp, unsigned max_cp);
+
+/* Index where the steady state of a timing series starts: the last change
+   point where the level drops, leaving at least a tenth of the series after
+   it. 0 if the series has no warmup phase */
+unsigned stats_steady_state_start (const double *x, unsigned n);
+
+/* One-sided Mann-Whitney U test of y tending to be larger than x, normal
+   approximation with tie and continuity corrections (reasonable from about
+   8 samples each). Returns the p-value */
+double stats_mann_whitney (const double *x, unsigned nx, const double *y, unsigned ny);
+
+/* Conversion helper for tick samples */
+void stats_from_uint64 (const uint64_t *in, unsigned n, double *out);
+
+#define STATS_NB_RESAMPLES 2000
+#define STATS_MAD_THRESHOLD 3.5
+
+#endif
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h> // strcmp
+#include <math.h>   // pow, lround
+
+#include "placement.h"
+#include "sweep.h"
+#include "topo.h"
+
+int sweep_parse (const char *str, struct sweep_spec *spec) {
+   char spacing [8] = "geom";
+
+   const int nb = sscanf (str, "%u:%u:%u:%7s", &spec->min, &spec->max, &spec->count, spacing);
+   if (nb < 3 || spec->min == 0 || spec->max < spec->min || spec->count == 0) return -1;
+
+   if (strcmp (spacing, "geom") == 0 || strcmp (spacing, "log") == 0)
+      spec->geometric = 1;
+   else if (strcmp (spacing, "lin") == 0)
+      spec->geometric = 0;
+   else
+      return -1;
+
+   return 0;
+}
+
+static unsigned point_size (const struct sweep_spec *spec, unsigned i) {
+   if (spec->count == 1) return spec->min;
+
+   const double f = (double) i / (spec->count - 1);
+   if (spec->geometric)
+      return (unsigned) lround (spec->min * pow ((double) spec->max / spec->min, f));
+
+   return (unsigned) lround (spec->min + f * (spec->max - spec->min));
+}
+
+static const char *level_name (const struct cache_level *c) {
+   static char name [8];
+
+   if (c == NULL) return "DRAM";
+   snprintf (name, sizeof name, "L%u", c->level);
+   return name;
+}
+
+void sweep_run (struct variant_result res[], unsigned nb, const struct protocol *proto,
+                const struct sweep_spec *spec, FILE *out) {
+   struct cache_level caches [TOPO_MAX_CACHES];
+   const unsigned nb_caches = topo_caches (caches);
+   const struct timer *timer = proto->timer;
+   unsigned i, v;
+
+   for (i=0; i<nb_caches; i++)
+      fprintf (out, "# L%u %s cache: %lu bytes, %u-byte lines\n", caches[i].level, caches[i].type,
+               caches[i].size, caches[i].line_size);
+   if (nb_caches == 0)
+      fprintf (out, "# cache hierarchy not found in sysfs, fits_in column is not meaningful\n");
+
+   if (proto->placement != NULL) {
+      fprintf (out, "# ");
+      placement_describe (proto->placement, out);
+   }
+
+   fprintf (out, "variant,size,working_set_bytes,fits_in,transition,repm,metas,"
+            "min_s_per_call,med_s_per_call,ci_pct,ns_per_element,gb_per_s\n");
+
+   for (v=0; v<nb; v++) {
+      const struct cache_level *prev_level = NULL;
+      unsigned prev_size = 0;
+
+      for (i=0; i<spec->count; i++) {
+         const unsigned size = point_size (spec, i);
+         if (size == prev_size) continue; /* rounding duplicates at small sizes */
+
+         struct protocol p = *proto;
+         p.size = size;
+         p.repm = bench_auto_repm (res[v].kv, &p, SWEEP_META_SECONDS);
+         fprintf (stderr, "[%s] size %u: %u measure repetitions\n", res[v].kv->name, size, p.repm);
+         bench_run_metas (&res[v], &p);
+
+         /* working set and elements from the cost model of the variant */
+         struct kernel_cost cost;
+         kernels_cost (res[v].kv, size, &cost);
+         const uint64_t ws = (uint64_t) cost.bytes;
+         const struct cache_level *level = topo_cache_fitting (caches, nb_caches, ws);
+         char transition [32] = "";
+         if (prev_size != 0 && level != prev_level) {
+            snprintf (transition, sizeof transition, "%s", level_name (prev_level));
+            snprintf (transition + strlen (transition), sizeof transition - strlen (transition),
+                      "->%s", level_name (level));
+         }
+
+         const double med_s = timer_seconds (timer, res[v].med) / p.repm; /* per call */
+         fprintf (out, "%s,%u,%lu,%s,%s,%u,%u,%.9f,%.9f,%.3f,%.4f,%.3f\n", res[v].kv->name, size, ws,
+                  level_name (level), transition, p.repm, res[v].nb_metas,
+                  timer_seconds (timer, res[v].min) / p.repm, med_s, bench_ci_width (&res[v]) * 100,
+                  med_s * 1e9 / cost.elems, med_s > 0 ? cost.bytes / med_s * 1e-9 : 0.0);
+         fflush (out);
+
+         prev_level = level;
+         prev_size = size;
+      }
+   }
+}
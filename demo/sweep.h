@@ -0,0 +1,28 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdio.h>
+
+#include "bench.h"
+
+/* Problem-size sweep of the measure driver: one CSV row per (variant, size)
+   with time per element, bandwidth and working set from the cost model of the
+   variant, annotated with the cache level holding the working set */
+
+struct sweep_spec {
+   unsigned min, max, count;
+   int geometric; /* constant ratio between sizes, else constant step */
+};
+
+#define SWEEP_WARMUP 10          /* warmup calls in the first meta of each size */
+#define SWEEP_META_SECONDS 0.01  /* measure repetitions adjusted to this meta duration */
+
+/* "<min>:<max>:<count>[:lin|geom|log]", log being the same as geom since the
+   working set grows as size^2. Returns -1 if invalid */
+int sweep_parse (const char *str, struct sweep_spec *spec);
+
+/* proto->size and proto->repm are set for each point */
+void sweep_run (struct variant_result res[], unsigned nb, const struct protocol *proto,
+                const struct sweep_spec *spec, FILE *out);
+
+#endif
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h> // strdup, strtok
+#include <math.h>   // ceil
+#include <time.h>   // clock_gettime
+
+#include "batch.h"
+#include "rng.h"
+#include "stats.h"
+#include "throughput.h"
+
+unsigned throughput_parse (const char *str, unsigned sizes [THROUGHPUT_MAX_POINTS]) {
+   char *list = strdup (str);
+   char *tok;
+   unsigned nb = 0;
+
+   for (tok = strtok (list, ","); tok != NULL && nb < THROUGHPUT_MAX_POINTS; tok = strtok (NULL, ",")) {
+      const int s = atoi (tok);
+      if (s <= 0) {
+         free (list);
+         return 0;
+      }
+      sizes [nb++] = s;
+   }
+   free (list);
+
+   return nb;
+}
+
+/* One batch solved by kernel_batch, or one variant call per problem */
+typedef void (*batch_fn_t) (const struct kernel_problem p[], unsigned nb, const struct kernel_variant *kv);
+
+static void run_batched (const struct kernel_problem p[], unsigned nb, const struct kernel_variant *kv) {
+   (void) kv;
+   kernel_batch (nb, p);
+}
+
+static void run_loop (const struct kernel_problem p[], unsigned nb, const struct kernel_variant *kv) {
+   unsigned k;
+
+   for (k=0; k<nb; k++)
+      kv->fn (p[k].n, p[k].a, p[k].b, (float (*)[p[k].n]) p[k].c);
+}
+
+struct rate {
+   double med_s;    /* median time per batch call */
+   double ci_width; /* relative width of its CI */
+   unsigned nb_metas;
+   int reached;     /* adaptive mode: target CI width reached */
+};
+
+static double wall_seconds (void) {
+   struct timespec ts;
+   clock_gettime (CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Median and CI of x[0..n-1] */
+static void update_rate (struct rate *r, const double x[], unsigned n) {
+   double lo, hi;
+
+   r->med_s = stats_median (x, n);
+   stats_bootstrap_median_ci (x, n, STATS_NB_RESAMPLES, CI_LEVEL, &lo, &hi);
+   r->ci_width = r->med_s > 0 ? (hi - lo) / r->med_s : 0.0;
+   r->nb_metas = n;
+}
+
+/* Fixed count of metas, or in adaptive mode the stop test of bench_run_metas:
+   up to proto->nb_metas metas until the median CI is narrow enough or the
+   budget is spent. Returns -1 if out of memory */
+static int measure (batch_fn_t fn, const struct kernel_variant *kv, const struct kernel_problem p[],
+                    unsigned nb, const struct protocol *proto, struct rate *r) {
+   const struct timer *timer = proto->timer;
+   double *x = malloc (proto->nb_metas * sizeof x[0]);
+   unsigned i, m;
+
+   if (x == NULL) return -1;
+
+   for (i=0; i<proto->repw; i++)
+      fn (p, nb, kv);
+
+   const uint64_t t1 = timer->start();
+   fn (p, nb, kv);
+   const uint64_t t2 = timer->stop();
+   const double call_ns = timer_ns (timer, timer_elapsed (timer, t1, t2));
+   double meta_ns = THROUGHPUT_META_SECONDS * 1e9;
+   if (meta_ns < 2000 * timer->resolution_ns) meta_ns = 2000 * timer->resolution_ns;
+   const unsigned repm = call_ns > 0 ? (unsigned) ceil (meta_ns / call_ns) : 1;
+
+   const double start = wall_seconds();
+   r->reached = 0;
+   for (m=0; m<proto->nb_metas; ) {
+      const uint64_t t3 = timer->start();
+      for (i=0; i<repm; i++)
+         fn (p, nb, kv);
+      const uint64_t t4 = timer->stop();
+      x[m++] = timer_seconds (timer, timer_elapsed (timer, t3, t4)) / repm;
+
+      if (proto->target_ci <= 0 || m < proto->min_metas) continue;
+      update_rate (r, x, m);
+      if (r->ci_width <= proto->target_ci) {
+         r->reached = 1;
+         break;
+      }
+      if (wall_seconds() - start >= proto->budget) break;
+   }
+   update_rate (r, x, m);
+
+   free (x);
+   return 0;
+}
+
+// TODO: adjust for each kernel
+/* Problem k takes streams 3k to 3k+2 */
+static void init_problem (struct kernel_problem *p, unsigned k, int parallel) {
+   const unsigned n = p->n;
+
+   rng_fill (n, p->a, RNG_SEED, 3 * (uint64_t) k, parallel);
+   rng_fill (n, p->b, RNG_SEED, 3 * (uint64_t) k + 1, parallel);
+   rng_fill ((size_t) n * n, p->c, RNG_SEED, 3 * (uint64_t) k + 2, parallel);
+}
+
+int throughput_run (const struct variant_result res[], unsigned nb, const struct protocol *proto,
+                    const unsigned batch_sizes[], unsigned nb_batch_sizes, FILE *out) {
+   const unsigned size = proto->size;
+   unsigned nb_missed = 0; /* adaptive mode: measures stopped before the target CI width */
+   int status = 0;
+   unsigned s, k, v;
+
+   if (proto->target_ci > 0)
+      fprintf (out, "Problems of size %u, adaptive: %u to %u metas per point until the %.0f%% CI of the median\n"
+               "is narrower than %.2f%% of it (budget %.0f s per point), rates in problems per second\n",
+               size, proto->min_metas, proto->nb_metas, CI_LEVEL * 100, proto->target_ci * 100, proto->budget);
+   else
+      fprintf (out, "Problems of size %u, %u metas per point, rates in problems per second\n",
+               size, proto->nb_metas);
+   fprintf (out, "\n%8s %14s %7s %6s", "BATCH", "BATCHED", "CI (%)", "METAS");
+   for (v=0; v<nb; v++)
+      fprintf (out, " %4s %-9.9s %7s", "LOOP", res[v].kv->name, "SPEEDUP");
+   fprintf (out, "\n");
+
+   if (proto->placement != NULL) placement_pin_threads (proto->placement);
+
+   for (s=0; s<nb_batch_sizes && status == 0; s++) {
+      const unsigned nb_pb = batch_sizes[s];
+      struct kernel_problem *p = malloc (nb_pb * sizeof p[0]);
+      if (p == NULL) {
+         status = -1;
+         break;
+      }
+
+      /* problems 0 to nb_alloc-1 to release, some arrays of the last one NULL on failure */
+      unsigned nb_alloc = 0;
+      for (k=0; k<nb_pb && status == 0; k++) {
+         p[k].n = size;
+         p[k].a = placement_alloc (proto->placement, size, sizeof p[k].a[0]);
+         p[k].b = placement_alloc (proto->placement, size, sizeof p[k].b[0]);
+         p[k].c = placement_alloc (proto->placement, size, size * sizeof p[k].c[0]);
+         nb_alloc++;
+         if (p[k].a == NULL || p[k].b == NULL || p[k].c == NULL)
+            status = -1;
+         else
+            init_problem (&p[k], k, placement_parallel_init (proto->placement));
+      }
+
+      struct rate batched, loop;
+      if (status != 0 || measure (run_batched, NULL, p, nb_pb, proto, &batched) != 0) {
+         status = -1;
+      } else {
+         fprintf (out, "%8u %14.0f %7.2f %6u", nb_pb, nb_pb / batched.med_s, batched.ci_width * 100,
+                  batched.nb_metas);
+         if (!batched.reached) nb_missed++;
+         for (v=0; v<nb; v++) {
+            if (measure (run_loop, res[v].kv, p, nb_pb, proto, &loop) != 0) {
+               status = -1;
+               break;
+            }
+            fprintf (out, " %14.0f %6.2fx", nb_pb / loop.med_s, loop.med_s / batched.med_s);
+            if (!loop.reached) nb_missed++;
+         }
+         fprintf (out, "\n");
+         fflush (out);
+      }
+
+      for (k=0; k<nb_alloc; k++) {
+         placement_free (proto->placement, p[k].a, size, sizeof p[k].a[0]);
+         placement_free (proto->placement, p[k].b, size, sizeof p[k].b[0]);
+         placement_free (proto->placement, p[k].c, size, size * sizeof p[k].c[0]);
+      }
+      free (p);
+   }
+   if (status != 0) {
+      fprintf (stderr, "Cannot allocate the throughput problems or samples\n");
+      return status;
+   }
+   fprintf (out, "(SPEEDUP: problems per second of kernel_batch over one variant call per problem)\n");
+   if (proto->target_ci > 0 && nb_missed > 0)
+      fprintf (out, "(%u measures stopped on the time budget or the max number of metas before the target CI width)\n",
+               nb_missed);
+
+   return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef THROUGHPUT_H
+#define THROUGHPUT_H
+
+#include <stdio.h>
+
+#include "bench.h"
+
+/* Throughput mode of the measure driver: batches of independent problems of
+   the protocol size, solved by kernel_batch in one parallel region or by one
+   call of each selected variant per problem. Problems per second against
+   batch size */
+
+#define THROUGHPUT_MAX_POINTS 64
+#define THROUGHPUT_META_SECONDS 0.01 /* batch calls per meta adjusted to this duration */
+
+/* "<n>,<n>,..." batch sizes. Returns their number, 0 if invalid */
+unsigned throughput_parse (const char *str, unsigned sizes [THROUGHPUT_MAX_POINTS]);
+
+/* proto->nb_metas metas per batch size and method (adaptive mode: up to
+   proto->nb_metas, same stop test as bench_run_metas), proto->repw warmup
+   calls. Returns -1 if out of memory */
+int throughput_run (const struct variant_result res[], unsigned nb, const struct protocol *proto,
+                    const unsigned batch_sizes[], unsigned nb_batch_sizes, FILE *out);
+
+#endif
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h> // qsort
+#include <stdint.h>
+#include <string.h> // strcmp
+#include <time.h>   // clock, clock_gettime
+#if defined __i386 || defined __amd64
+#include <cpuid.h>
+#endif
+
+#include "rdtsc.h"
+#include "timer.h"
+
+#define NB_PROBES 1000
+
+static uint64_t clock_read (void) {
+   return (uint64_t) clock();
+}
+
+static uint64_t ts_to_ns (const struct timespec *ts) {
+   return (uint64_t) ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static uint64_t mono_read (void) {
+   struct timespec ts;
+   clock_gettime (CLOCK_MONOTONIC_RAW, &ts);
+   return ts_to_ns (&ts);
+}
+
+static uint64_t thread_read (void) {
+   struct timespec ts;
+   clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+   return ts_to_ns (&ts);
+}
+
+static uint64_t tsc_start (void) {
+   return rdtsc_start();
+}
+
+static uint64_t tsc_stop (void) {
+   return rdtsc_stop();
+}
+
+static struct timer timers[] = {
+   { "clock",  "clock(): CPU time summed over all threads (legacy)",
+     clock_read, clock_read, 1e9 / CLOCKS_PER_SEC, 0, 0.0 },
+   { "mono",   "clock_gettime(CLOCK_MONOTONIC_RAW): wall-clock",
+     mono_read, mono_read, 1.0, 0, 0.0 },
+   { "tsc",    "rdtsc/rdtscp: invariant time-stamp counter, calibrated to ns",
+     tsc_start, tsc_stop, 0.0, 0, 0.0 },
+   { "thread", "clock_gettime(CLOCK_THREAD_CPUTIME_ID): CPU time of the calling thread",
+     thread_read, thread_read, 1.0, 0, 0.0 },
+};
+#define NB_TIMERS (sizeof timers / sizeof timers[0])
+
+struct timer *timer_find (const char *name) {
+   unsigned i;
+
+   for (i=0; i<NB_TIMERS; i++)
+      if (strcmp (timers[i].name, name) == 0)
+         return &timers[i];
+
+   return NULL;
+}
+
+void timer_list (FILE *fp) {
+   unsigned i;
+
+   for (i=0; i<NB_TIMERS; i++)
+      fprintf (fp, "  %-7s %s\n", timers[i].name, timers[i].desc);
+}
+
+static int cmp_uint64 (const void *a, const void *b) {
+   const uint64_t va = *((uint64_t *) a);
+   const uint64_t vb = *((uint64_t *) b);
+
+   if (va < vb) return -1;
+   if (va > vb) return 1;
+   return 0;
+}
+
+/* Invariant TSC: constant rate across P-/C-states (CPUID 0x80000007, EDX bit 8) */
+static int tsc_is_invariant (void) {
+#if defined __i386 || defined __amd64
+   unsigned eax, ebx, ecx, edx;
+   if (!__get_cpuid (0x80000007, &eax, &ebx, &ecx, &edx)) return 0;
+   return (edx >> 8) & 1;
+#elif defined __aarch64__
+   return 1;
+#else
+   return -1;
+#endif
+}
+
+/* ns per TSC tick against CLOCK_MONOTONIC_RAW over ~50 ms */
+static double tsc_calibrate (void) {
+   const struct timespec wait = { .tv_sec = 0, .tv_nsec = 50 * 1000 * 1000 };
+
+   const uint64_t ns1 = mono_read();
+   const uint64_t t1 = rdtsc_start();
+   nanosleep (&wait, NULL);
+   const uint64_t ns2 = mono_read();
+   const uint64_t t2 = rdtsc_stop();
+
+   return (double) (ns2 - ns1) / (double) (t2 - t1);
+}
+
+int timer_init (struct timer *t) {
+   unsigned i;
+
+   if (t->start == tsc_start) {
+      const int inv = tsc_is_invariant();
+      if (inv < 0) {
+         fprintf (stderr, "Timer %s: no time-stamp counter on this architecture\n", t->name);
+         return -1;
+      }
+      if (inv == 0)
+         fprintf (stderr, "Warning: TSC is not invariant, tsc timings depend on core frequency\n");
+      t->ns_per_tick = tsc_calibrate();
+   }
+
+   /* overhead: median of empty start/stop pairs */
+   uint64_t probes [NB_PROBES];
+   for (i=0; i<NB_PROBES; i++) {
+      const uint64_t t1 = t->start();
+      const uint64_t t2 = t->stop();
+      probes[i] = t2 - t1;
+   }
+   qsort (probes, NB_PROBES, sizeof probes[0], cmp_uint64);
+   t->overhead = probes [NB_PROBES/2];
+
+   /* resolution: smallest non-zero step between consecutive reads */
+   uint64_t step = UINT64_MAX;
+   for (i=0; i<NB_PROBES; i++) {
+      const uint64_t t1 = t->stop();
+      uint64_t t2;
+      unsigned spin = 0;
+      do {
+         t2 = t->stop();
+      } while (t2 == t1 && ++spin < 100000000);
+      if (t2 > t1 && t2 - t1 < step) step = t2 - t1;
+      if (t2 == t1) break; /* frozen counter */
+   }
+   if (step == UINT64_MAX) {
+      fprintf (stderr, "Timer %s: counter does not advance\n", t->name);
+      return -1;
+   }
+   t->resolution_ns = step * t->ns_per_tick;
+
+   return 0;
+}
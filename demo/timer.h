@@ -0,0 +1,45 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Timing backends for the drivers. Values returned by start/stop are ticks
+   of the backend, converted to nanoseconds with ns_per_tick */
+struct timer {
+   const char *name;
+   const char *desc;
+   uint64_t (*start) (void);
+   uint64_t (*stop) (void);
+   double ns_per_tick;   /* set by timer_init for backends needing calibration */
+   uint64_t overhead;    /* ticks taken by an empty start/stop pair */
+   double resolution_ns; /* smallest observable non-zero difference */
+};
+
+#define TIMER_DEFAULT "mono"
+
+/* Backend by name (clock, mono, tsc, thread), NULL if unknown or unavailable */
+struct timer *timer_find (const char *name);
+
+/* Calibrates ns_per_tick (tsc) and measures overhead and resolution.
+   Returns -1 if the backend cannot be used on this host */
+int timer_init (struct timer *t);
+
+/* Prints the backends list with descriptions */
+void timer_list (FILE *fp);
+
+/* Elapsed ticks minus timer overhead, never negative */
+static inline uint64_t timer_elapsed (const struct timer *t, uint64_t t1, uint64_t t2) {
+   const uint64_t d = t2 - t1;
+   return d > t->overhead ? d - t->overhead : 0;
+}
+
+static inline double timer_ns (const struct timer *t, uint64_t ticks) {
+   return ticks * t->ns_per_tick;
+}
+
+static inline double timer_seconds (const struct timer *t, uint64_t ticks) {
+   return ticks * t->ns_per_tick * 1e-9;
+}
+
+#endif
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h> // strtoull, qsort
+#include <string.h> // strcmp, strncmp, strchr
+
+#include "topo.h"
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+#define SYSFS_NODE "/sys/devices/system/node"
+
+/* First line of a sysfs file, -1 if missing */
+static int read_line (const char *path, char *buf, size_t len) {
+   FILE *fp = fopen (path, "r");
+   if (fp == NULL) return -1;
+
+   const int ok = fgets (buf, len, fp) != NULL;
+   fclose (fp);
+   if (!ok) return -1;
+
+   buf [strcspn (buf, "\n")] = '\0';
+   return 0;
+}
+
+/* "48K", "2048K", "32M" */
+static uint64_t parse_size (const char *s) {
+   char *end;
+   uint64_t v = strtoull (s, &end, 10);
+
+   switch (*end) {
+   case 'K': v <<= 10; break;
+   case 'M': v <<= 20; break;
+   case 'G': v <<= 30; break;
+   }
+
+   return v;
+}
+
+static int cmp_level (const void *a, const void *b) {
+   const struct cache_level *ca = a;
+   const struct cache_level *cb = b;
+
+   return (int) ca->level - (int) cb->level;
+}
+
+unsigned topo_caches (struct cache_level caches [TOPO_MAX_CACHES]) {
+   char path [256], buf [64];
+   unsigned idx, nb = 0;
+
+   for (idx=0; nb < TOPO_MAX_CACHES; idx++) {
+      snprintf (path, sizeof path, SYSFS_CPU "/cpu0/cache/index%u/type", idx);
+      if (read_line (path, buf, sizeof buf) != 0) break;
+      if (strcmp (buf, "Instruction") == 0) continue;
+
+      struct cache_level *c = &caches[nb];
+      snprintf (c->type, sizeof c->type, "%.15s", buf);
+
+      snprintf (path, sizeof path, SYSFS_CPU "/cpu0/cache/index%u/level", idx);
+      if (read_line (path, buf, sizeof buf) != 0) continue;
+      c->level = atoi (buf);
+
+      snprintf (path, sizeof path, SYSFS_CPU "/cpu0/cache/index%u/size", idx);
+      if (read_line (path, buf, sizeof buf) != 0) continue;
+      c->size = parse_size (buf);
+
+      snprintf (path, sizeof path, SYSFS_CPU "/cpu0/cache/index%u/coherency_line_size", idx);
+      c->line_size = read_line (path, buf, sizeof buf) == 0 ? atoi (buf) : 64;
+
+      nb++;
+   }
+   qsort (caches, nb, sizeof caches[0], cmp_level);
+
+   return nb;
+}
+
+const struct cache_level *topo_cache_fitting (const struct cache_level caches[], unsigned nb,
+                                              uint64_t ws) {
+   unsigned i;
+
+   for (i=0; i<nb; i++)
+      if (ws <= caches[i].size)
+         return &caches[i];
+
+   return NULL;
+}
+
+unsigned topo_parse_list (const char *str, unsigned *ids, unsigned max) {
+   unsigned nb = 0;
+   const char *p = str;
+
+   while (*p != '\0' && nb < max) {
+      char *end;
+      const unsigned first = strtoul (p, &end, 10);
+      if (end == p) break;
+      unsigned last = first;
+      if (*end == '-') {
+         p = end + 1;
+         last = strtoul (p, &end, 10);
+      }
+      unsigned id;
+      for (id = first; id <= last && nb < max; id++)
+         ids [nb++] = id;
+      p = *end == ',' ? end + 1 : end;
+      if (*end != ',') break;
+   }
+
+   return nb;
+}
+
+static unsigned read_uint (const char *fmt, unsigned cpu, unsigned dflt) {
+   char path [256], buf [64];
+
+   snprintf (path, sizeof path, fmt, cpu);
+   return read_line (path, buf, sizeof buf) == 0 ? (unsigned) atoi (buf) : dflt;
+}
+
+/* NUMA nodes from /sys/devices/system/node/node<N>/cpulist */
+static void assign_nodes (struct cpu_info cpus[], unsigned nb) {
+   static unsigned nodes [TOPO_MAX_CPUS], ids [TOPO_MAX_CPUS];
+   char path [256], buf [1024];
+   unsigned n, i, j;
+
+   if (read_line (SYSFS_NODE "/online", buf, sizeof buf) != 0) return;
+   const unsigned nb_nodes = topo_parse_list (buf, nodes, TOPO_MAX_CPUS);
+
+   for (n=0; n<nb_nodes; n++) {
+      snprintf (path, sizeof path, SYSFS_NODE "/node%u/cpulist", nodes[n]);
+      if (read_line (path, buf, sizeof buf) != 0) continue;
+      const unsigned nb_ids = topo_parse_list (buf, ids, TOPO_MAX_CPUS);
+      for (i=0; i<nb_ids; i++)
+         for (j=0; j<nb; j++)
+            if (cpus[j].cpu == ids[i]) cpus[j].node = nodes[n];
+   }
+}
+
+unsigned topo_mem_nodes (unsigned *nodes, unsigned max) {
+   char buf [1024];
+
+   if (read_line (SYSFS_NODE "/has_memory", buf, sizeof buf) != 0) return 0;
+   return topo_parse_list (buf, nodes, max);
+}
+
+static int cmp_cpu (const void *a, const void *b) {
+   const struct cpu_info *ca = a;
+   const struct cpu_info *cb = b;
+
+   if (ca->package != cb->package) return ca->package < cb->package ? -1 : 1;
+   if (ca->core != cb->core) return ca->core < cb->core ? -1 : 1;
+   return ca->cpu < cb->cpu ? -1 : ca->cpu > cb->cpu;
+}
+
+unsigned topo_cpus (struct cpu_info cpus [TOPO_MAX_CPUS]) {
+   static unsigned ids [TOPO_MAX_CPUS];
+   char buf [1024];
+   unsigned i, nb = 0;
+
+   if (read_line (SYSFS_CPU "/online", buf, sizeof buf) == 0)
+      nb = topo_parse_list (buf, ids, TOPO_MAX_CPUS);
+   if (nb == 0) {
+      ids[0] = 0;
+      nb = 1;
+   }
+
+   for (i=0; i<nb; i++) {
+      cpus[i].cpu = ids[i];
+      cpus[i].core = read_uint (SYSFS_CPU "/cpu%u/topology/core_id", ids[i], ids[i]);
+      cpus[i].package = read_uint (SYSFS_CPU "/cpu%u/topology/physical_package_id", ids[i], 0);
+      cpus[i].node = 0;
+   }
+   assign_nodes (cpus, nb);
+   qsort (cpus, nb, sizeof cpus[0], cmp_cpu);
+
+   /* SMT rank: position among CPUs sharing package and core */
+   for (i=0; i<nb; i++)
+      cpus[i].smt_rank = i > 0 && cpus[i].package == cpus[i-1].package &&
+                         cpus[i].core == cpus[i-1].core ? cpus[i-1].smt_rank + 1 : 0;
+
+   return nb;
+}
+
+void topo_cpu_model (char *buf, size_t len) {
+   char line [512];
+   size_t i;
+
+   snprintf (buf, len, "unknown");
+
+   /* x86: "model name", aarch64 kernels without it: "CPU part" */
+   FILE *fp = fopen ("/proc/cpuinfo", "r");
+   if (fp == NULL) return;
+   while (fgets (line, sizeof line, fp) != NULL) {
+      if (strncmp (line, "model name", 10) != 0 && strncmp (line, "CPU part", 8) != 0) continue;
+      const char *colon = strchr (line, ':');
+      if (colon == NULL) continue;
+      colon += strspn (colon + 1, " \t") + 1;
+      snprintf (buf, len, "%.*s", (int) strcspn (colon, "\n"), colon);
+      if (strncmp (line, "model name", 10) == 0) break;
+   }
+   fclose (fp);
+
+   for (i=0; buf[i] != '\0'; i++)
+      if (buf[i] == ' ' || buf[i] == '\t') buf[i] = '_';
+}
@@ -0,0 +1,50 @@
+#ifndef TOPO_H
+#define TOPO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Host topology read from /sys/devices/system/cpu */
+
+#define TOPO_MAX_CACHES 8
+
+struct cache_level {
+   unsigned level;      /* 1, 2, 3... */
+   char type [16];      /* Data, Unified */
+   uint64_t size;       /* bytes */
+   unsigned line_size;  /* bytes */
+};
+
+/* Data and unified caches of cpu0 sorted by level. Returns their number,
+   0 if sysfs does not describe them */
+unsigned topo_caches (struct cache_level caches [TOPO_MAX_CACHES]);
+
+/* Smallest cache holding ws bytes, NULL if ws exceeds the last level */
+const struct cache_level *topo_cache_fitting (const struct cache_level caches[], unsigned nb,
+                                              uint64_t ws);
+
+#define TOPO_MAX_CPUS 1024
+
+struct cpu_info {
+   unsigned cpu;      /* OS index, as in sched_setaffinity */
+   unsigned core;     /* core_id, unique within a package */
+   unsigned package;  /* physical_package_id (socket) */
+   unsigned node;     /* NUMA node, 0 without NUMA support */
+   unsigned smt_rank; /* rank among the hardware threads of its core, 0 for the first */
+};
+
+/* Online CPUs sorted by package, core then SMT rank. Returns their number,
+   at least 1 (cpu0 with default ids if sysfs is not readable) */
+unsigned topo_cpus (struct cpu_info cpus [TOPO_MAX_CPUS]);
+
+/* NUMA nodes with memory. Returns their number, 0 without NUMA support */
+unsigned topo_mem_nodes (unsigned *nodes, unsigned max);
+
+/* CPU model name from /proc/cpuinfo with blanks replaced by '_', "unknown"
+   if not found */
+void topo_cpu_model (char *buf, size_t len);
+
+/* Parses a sysfs CPU list ("0-3,8,10-11") into ids. Returns their number */
+unsigned topo_parse_list (const char *str, unsigned *ids, unsigned max);
+
+#endif
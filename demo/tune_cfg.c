@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // strcmp
+
+#include "tune_cfg.h"
+
+#define LINE_MAX_LEN 1024
+
+static const char *schedules[] = { "static", "dynamic", "guided" };
+
+unsigned tune_size_bucket (unsigned size) {
+   unsigned bucket = 1;
+
+   while (bucket <= size / 2) bucket *= 2;
+
+   return bucket;
+}
+
+/* Parses one entry, skipping comments and blank lines. Returns 0 on success */
+static int parse_line (const char *line, struct tune_entry *e) {
+   char schedule [16];
+   unsigned i;
+
+   if (line[0] == '#') return -1;
+   if (sscanf (line, "%127s %u %u %u %u %15s %u %u %255s %lf", e->cpu, &e->bucket,
+               &e->params.unroll, &e->params.nb_acc, &e->params.row_block, schedule,
+               &e->params.chunk, &e->params.threads, e->object, &e->seconds) != 10)
+      return -1;
+
+   /* static string, so that entries outlive the line buffer */
+   for (i=0; i<sizeof schedules / sizeof schedules[0]; i++)
+      if (strcmp (schedule, schedules[i]) == 0) {
+         e->params.schedule = schedules[i];
+         return 0;
+      }
+
+   return -1;
+}
+
+static void print_entry (FILE *fp, const struct tune_entry *e) {
+   fprintf (fp, "%s %u %u %u %u %s %u %u %s %.9f\n", e->cpu, e->bucket, e->params.unroll,
+            e->params.nb_acc, e->params.row_block, e->params.schedule, e->params.chunk,
+            e->params.threads, e->object, e->seconds);
+}
+
+int tune_cfg_read (const char *path, const char *cpu, unsigned size, struct tune_entry *e) {
+   char line [LINE_MAX_LEN];
+   struct tune_entry cur;
+   const unsigned bucket = tune_size_bucket (size);
+   int found = -1;
+
+   FILE *fp = fopen (path, "r");
+   if (fp == NULL) return -1;
+
+   /* last entry wins */
+   while (fgets (line, sizeof line, fp) != NULL) {
+      if (parse_line (line, &cur) != 0) continue;
+      if (cur.bucket != bucket || strcmp (cur.cpu, cpu) != 0) continue;
+      *e = cur;
+      found = 0;
+   }
+
+   fclose (fp);
+
+   return found;
+}
+
+int tune_cfg_write (const char *path, const struct tune_entry *e) {
+   char line [LINE_MAX_LEN];
+   struct tune_entry cur;
+
+   /* keep other entries, written to a temporary file renamed over path */
+   char *tmp_path = malloc (strlen (path) + 5);
+   sprintf (tmp_path, "%s.tmp", path);
+
+   FILE *out = fopen (tmp_path, "w");
+   if (out == NULL) {
+      fprintf (stderr, "Cannot write to %s\n", tmp_path);
+      free (tmp_path);
+      return -1;
+   }
+   fprintf (out, "# cpu bucket unroll nb_acc row_block schedule chunk threads object seconds (written by tune)\n");
+
+   FILE *in = fopen (path, "r");
+   if (in != NULL) {
+      while (fgets (line, sizeof line, in) != NULL) {
+         if (parse_line (line, &cur) != 0) continue;
+         if (cur.bucket == e->bucket && strcmp (cur.cpu, e->cpu) == 0) continue;
+         print_entry (out, &cur);
+      }
+      fclose (in);
+   }
+   print_entry (out, e);
+
+   const int err = fclose (out) != 0 || rename (tmp_path, path) != 0;
+   if (err) fprintf (stderr, "Cannot write to %s\n", path);
+   free (tmp_path);
+
+   return err ? -1 : 0;
+}
@@ -0,0 +1,39 @@
+#ifndef TUNE_CFG_H
+#define TUNE_CFG_H
+
+/* Best kernel configurations found by ./tune, per (CPU model, size bucket),
+   read back by ./measure -u. One line per entry:
+   "<cpu model> <bucket> <unroll> <nb acc> <row block> <schedule> <chunk> <threads> <object> <seconds>" */
+
+#define TUNE_CFG_DEFAULT "tune.cfg"
+#define TUNE_DIR_DEFAULT "tune.d"       /* compiled candidates */
+#define TUNE_TEMPLATE_DEFAULT "tune_templates/kernel_tune.c"
+
+#define TUNE_NAME_LEN 128
+#define TUNE_PATH_LEN 256
+
+struct tune_params {
+   unsigned unroll, nb_acc, row_block;
+   const char *schedule; /* "static", "dynamic" or "guided" */
+   unsigned chunk;       /* 0: OpenMP default */
+   unsigned threads;     /* 0: OpenMP default */
+};
+
+struct tune_entry {
+   char cpu [TUNE_NAME_LEN];
+   unsigned bucket;
+   struct tune_params params;
+   char object [TUNE_PATH_LEN]; /* shared object of the winner, absolute path */
+   double seconds;              /* median time per call when tuned */
+};
+
+/* Size bucket: largest power of two not above size */
+unsigned tune_size_bucket (unsigned size);
+
+/* Adds or replaces the entry of (cpu, bucket). Returns -1 on I/O error */
+int tune_cfg_write (const char *path, const struct tune_entry *e);
+
+/* Returns 0 and fills e if an entry for (cpu, bucket of size) exists, -1 otherwise */
+int tune_cfg_read (const char *path, const char *cpu, unsigned size, struct tune_entry *e);
+
+#endif
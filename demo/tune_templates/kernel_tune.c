@@ -0,0 +1,75 @@
+/* Template of the autotuned kernel variants: ./tune compiles it into a
+   dlopen-able object per candidate, with
+     TUNE_UNROLL     elements of a row per inner iteration
+     TUNE_NB_ACC     independent accumulators per row (divides TUNE_UNROLL)
+     TUNE_ROW_BLOCK  rows summed together in the same column loop
+     TUNE_SCHEDULE   OpenMP schedule kind over row blocks (static, dynamic, guided)
+     TUNE_CHUNK      schedule chunk size in row blocks, 0 for the default
+     TUNE_THREADS    OpenMP threads, 0 for the default */
+#include <omp.h>
+
+#ifndef TUNE_UNROLL
+#define TUNE_UNROLL 4
+#endif
+#ifndef TUNE_NB_ACC
+#define TUNE_NB_ACC 4
+#endif
+#ifndef TUNE_ROW_BLOCK
+#define TUNE_ROW_BLOCK 1
+#endif
+#ifndef TUNE_SCHEDULE
+#define TUNE_SCHEDULE static
+#endif
+#ifndef TUNE_CHUNK
+#define TUNE_CHUNK 0
+#endif
+#ifndef TUNE_THREADS
+#define TUNE_THREADS 0
+#endif
+
+#if TUNE_CHUNK > 0
+#define TUNE_SCHEDULE_CLAUSE schedule(TUNE_SCHEDULE, TUNE_CHUNK)
+#else
+#define TUNE_SCHEDULE_CLAUSE schedule(TUNE_SCHEDULE)
+#endif
+
+#if TUNE_THREADS > 0
+#define TUNE_THREADS_CLAUSE num_threads(TUNE_THREADS)
+#else
+#define TUNE_THREADS_CLAUSE
+#endif
+
+/* Sums of nb_rows (<= TUNE_ROW_BLOCK) consecutive rows of length n */
+static void block_sums (unsigned n, unsigned nb_rows, const float *rows, float sums[]) {
+    float acc [TUNE_ROW_BLOCK][TUNE_NB_ACC] = { { 0.0f } };
+    unsigned j, r, u;
+
+    for (j = 0; j + TUNE_UNROLL <= n; j += TUNE_UNROLL)
+        for (r = 0; r < nb_rows; r++)
+            for (u = 0; u < TUNE_UNROLL; u++)
+                acc [r][u % TUNE_NB_ACC] += rows [r * n + j + u];
+
+    for (r = 0; r < nb_rows; r++) {
+        float sum = 0.0f;
+        for (u = 0; u < TUNE_NB_ACC; u++)
+            sum += acc[r][u];
+        for (u = j; u < n; u++)
+            sum += rows [r * n + u];
+        sums[r] = sum;
+    }
+}
+
+void kernel (unsigned n, float a[n], float b[n], float c[n][n]) {
+    const unsigned nb_blocks = (n + TUNE_ROW_BLOCK - 1) / TUNE_ROW_BLOCK;
+
+#pragma omp parallel for TUNE_SCHEDULE_CLAUSE TUNE_THREADS_CLAUSE
+    for (unsigned k = 0; k < nb_blocks; k++) {
+        const unsigned i0 = k * TUNE_ROW_BLOCK;
+        const unsigned nb_rows = i0 + TUNE_ROW_BLOCK <= n ? TUNE_ROW_BLOCK : n - i0;
+        float sums [TUNE_ROW_BLOCK];
+
+        block_sums (n, nb_rows, c[i0], sums);
+        for (unsigned r = 0; r < nb_rows; r++)
+            a[i0+r] += sums[r] / b[i0+r];
+    }
+}